@@ -0,0 +1,119 @@
+#ifndef QF633_CODE_BENCHUTIL_H
+#define QF633_CODE_BENCHUTIL_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "BSAnalytics.h"
+#include "Date.h"
+#include "Msg.h"
+#include "TickGenerator.h"
+
+// Synthetic market data and timing shared by the benchmark programs.
+
+// one snapshot message quoting numExpiries weekly expiries with strikesPerExpiry calls and puts each
+inline Msg SyntheticSnap(int numExpiries, int strikesPerExpiry, const char *underlying = "BTC")
+{
+    static const char *months[] = {"JAN", "FEB", "MAR", "APR", "MAY", "JUN", "JUL", "AUG", "SEP", "OCT", "NOV", "DEC"};
+    const uint64_t now = 1651795200000ULL; // 2022-05-06T00:00:00Z
+    const double fwd = 36000;
+    Msg msg;
+    msg.isSet = true;
+    msg.isSnap = true;
+    msg.timestamp = now;
+    for (int e = 0; e < numExpiries; e++) {
+        const uint64_t expiryMs = now + (7ULL * (e + 1)) * 86400000ULL;
+        const datetime_t expiryDate = datetime_t::FromUnixMS(expiryMs);
+        const double T = YearFraction(expiryMs - now);
+        char expiry[16];
+        std::snprintf(expiry, sizeof(expiry), "%d%s%02d", expiryDate.Day(), months[expiryDate.Month() - 1],
+                      expiryDate.Year() % 100);
+        for (int i = 0; i < strikesPerExpiry; i++) {
+            const double k = std::round(fwd * std::exp(1.5 * (i - strikesPerExpiry / 2.0) / strikesPerExpiry) / 100) * 100;
+            const double vol = 0.6 + 0.1 * std::log(k / fwd) * std::log(k / fwd) - 0.05 * std::log(k / fwd);
+            for (bool isCall : {true, false}) {
+                TickData t{};
+                char name[64];
+                std::snprintf(name, sizeof(name), "%s-%s-%.0f-%c", underlying, expiry, k, isCall ? 'C' : 'P');
+                t.InstrumentId = InstrumentRegistry::Instance().Intern(name);
+                const double price = bsUndisc(isCall ? Call : Put, k, fwd, T, vol) / fwd;
+                t.BestBidPrice = price * 0.99;
+                t.BestAskPrice = price * 1.01;
+                t.MarkPrice = price;
+                t.BestBidIV = vol * 100 - 1;
+                t.BestAskIV = vol * 100 + 1;
+                t.MarkIV = vol * 100;
+                t.BestBidAmount = t.BestAskAmount = 1;
+                t.UnderlyingIndexId = InstrumentRegistry::Instance().InternIndex(std::string("SYN.") + underlying + "-" + expiry);
+                t.UnderlyingPrice = fwd;
+                t.LastPrice = price;
+                t.OpenInterest = 100;
+                t.LastUpdateTimeStamp = now + e * 10 + i;
+                msg.Updates.push_back(t);
+            }
+        }
+    }
+    return msg;
+}
+
+template <class F>
+double SecondsPerCall(F &&f, int minIterations = 3, double minSeconds = 0.5)
+{
+    int iterations = 0;
+    const auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed{};
+    do {
+        f();
+        iterations++;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (iterations < minIterations || elapsed.count() < minSeconds);
+    return elapsed.count() / iterations;
+}
+
+// a snapshot of every underlying followed by numUpdates single-quote updates 250ms apart, with the vols drifting
+inline std::vector<Msg> SyntheticStream(const std::vector<const char *> &underlyings, int numExpiries,
+                                        int strikesPerExpiry, int numUpdates)
+{
+    std::vector<Msg> msgs(1);
+    for (const char *underlying : underlyings) {
+        Msg snap = SyntheticSnap(numExpiries, strikesPerExpiry, underlying);
+        msgs[0].timestamp = snap.timestamp;
+        msgs[0].Updates.insert(msgs[0].Updates.end(), snap.Updates.begin(), snap.Updates.end());
+    }
+    msgs[0].isSet = msgs[0].isSnap = true;
+    const std::vector<TickData> contracts = msgs[0].Updates;
+    uint64_t state = 633;
+    for (int i = 0; i < numUpdates; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        TickData t = contracts[(state >> 33) % contracts.size()];
+        const double bump = 1 + 0.05 * ((state >> 11) % 1000 / 1000.0 - 0.5);
+        t.BestBidIV *= bump;
+        t.BestAskIV *= bump;
+        t.MarkIV *= bump;
+        t.LastUpdateTimeStamp = msgs[0].timestamp + 250 * (i + 1);
+        Msg msg;
+        msg.isSet = true;
+        msg.isSnap = false;
+        msg.timestamp = t.LastUpdateTimeStamp;
+        msg.Updates.push_back(t);
+        msgs.push_back(std::move(msg));
+    }
+    return msgs;
+}
+
+// writes msgs in the tick data csv layout CsvFeeder reads
+inline void WriteTickCsv(const std::string &path, const std::vector<Msg> &msgs)
+{
+    std::ofstream out(path);
+    WriteTickCsvHeader(out);
+    for (const Msg &msg : msgs)
+        WriteTickCsvRows(out, msg);
+}
+
+#endif // QF633_CODE_BENCHUTIL_H
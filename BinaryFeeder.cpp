@@ -0,0 +1,130 @@
+#include "BinaryFeeder.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// reads count length-prefixed names starting at p, returns the position after the last one
+const char* ReadSymbols(const char* p, const char* end, uint32_t count, std::vector<std::string>& names)
+{
+    names.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        uint16_t len;
+        if (end - p < static_cast<std::ptrdiff_t>(sizeof(len))) {
+            throw std::invalid_argument("truncated symbol table in binary tick log");
+        }
+        std::memcpy(&len, p, sizeof(len));
+        p += sizeof(len);
+        if (end - p < len) {
+            throw std::invalid_argument("truncated symbol table in binary tick log");
+        }
+        names.emplace_back(p, len);
+        p += len;
+    }
+    return p;
+}
+
+} // namespace
+
+BinaryFeeder::BinaryFeeder(const std::string ticker_filename,
+                           FeedListener feed_listener,
+                           std::chrono::minutes interval,
+                           TimerListener timer_listener)
+        : file_(ticker_filename),
+          feed_listener_(feed_listener),
+          interval_(interval),
+          timer_listener_(timer_listener) {
+    BinaryTickLogHeader header;
+    if (file_.Size() < sizeof(header)) {
+        throw std::invalid_argument(ticker_filename + " is not a binary tick log");
+    }
+    std::memcpy(&header, file_.Data(), sizeof(header));
+    if (std::memcmp(header.Magic, BinaryTickLogMagic, sizeof(header.Magic)) != 0) {
+        throw std::invalid_argument(ticker_filename + " is not a binary tick log");
+    }
+    if (header.Version != BinaryTickLogVersion || header.RecordSize != sizeof(TickRecord)) {
+        throw std::invalid_argument(ticker_filename + ": unsupported binary tick log version");
+    }
+    if (header.RecordsOffset % alignof(TickRecord) != 0 || header.RecordsOffset > file_.Size() ||
+        (file_.Size() - header.RecordsOffset) / sizeof(TickRecord) < header.NumRecords) {
+        throw std::invalid_argument(ticker_filename + ": truncated binary tick log");
+    }
+
+    const char* symbols = file_.Data() + sizeof(header);
+    const char* symbolsEnd = file_.Data() + header.RecordsOffset;
+    symbols = ReadSymbols(symbols, symbolsEnd, header.NumContracts, contract_names_);
+    ReadSymbols(symbols, symbolsEnd, header.NumUnderlyings, underlying_names_);
+
+    // names are interned once here instead of once per record
+    InstrumentRegistry& registry = InstrumentRegistry::Instance();
+    instrument_ids_.reserve(contract_names_.size());
+    for (const auto& name : contract_names_) {
+        instrument_ids_.push_back(registry.Intern(name));
+    }
+    index_ids_.reserve(underlying_names_.size());
+    for (const auto& name : underlying_names_) {
+        index_ids_.push_back(registry.InternIndex(name));
+    }
+
+    records_ = reinterpret_cast<const TickRecord*>(file_.Data() + header.RecordsOffset);
+    num_records_ = header.NumRecords;
+
+    ReadNext();
+    if (msg_.isSet) {
+        // initialize interval timer now_ms_
+        now_ms_ = msg_.timestamp;
+    } else {
+        throw std::invalid_argument("empty message at initialization");
+    }
+}
+
+bool BinaryFeeder::ReadNext() {
+    msg_.Updates.clear();
+    msg_.isSet = false;
+    while (next_record_ < num_records_) {
+        const TickRecord& r = records_[next_record_];
+        if (msg_.isSet && (r.Flags & TickRecordMsgBegin)) {
+            break;
+        }
+        if (r.Contract >= instrument_ids_.size() || r.Underlying >= index_ids_.size()) {
+            throw std::invalid_argument("binary tick log record " + std::to_string(next_record_) +
+                                        " refers to a symbol outside the symbol table");
+        }
+        next_record_++;
+        msg_.isSet = true;
+        msg_.isSnap = (r.Flags & TickRecordSnap) != 0;
+        msg_.timestamp = r.LastUpdateTimeStamp;
+
+        TickData& update = msg_.Updates.emplace_back();
+        update.InstrumentId = instrument_ids_[r.Contract];
+        update.BestBidPrice = r.BestBidPrice;
+        update.BestBidAmount = r.BestBidAmount;
+        update.BestBidIV = r.BestBidIV;
+        update.BestAskPrice = r.BestAskPrice;
+        update.BestAskAmount = r.BestAskAmount;
+        update.BestAskIV = r.BestAskIV;
+        update.MarkPrice = r.MarkPrice;
+        update.MarkIV = r.MarkIV;
+        update.UnderlyingIndexId = index_ids_[r.Underlying];
+        update.UnderlyingPrice = r.UnderlyingPrice;
+        update.LastPrice = r.LastPrice;
+        update.OpenInterest = r.OpenInterest;
+        update.LastUpdateTimeStamp = r.LastUpdateTimeStamp;
+    }
+    return msg_.isSet;
+}
+
+bool BinaryFeeder::Step() {
+    if (msg_.isSet) {
+        feed_listener_(msg_);
+
+        // same timer semantics as CsvFeeder::Step
+        if (now_ms_ < msg_.timestamp) {
+            timer_listener_(now_ms_);
+            now_ms_ += interval_.count();
+        }
+        return ReadNext();
+    }
+    return false;
+}
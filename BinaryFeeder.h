@@ -0,0 +1,45 @@
+#ifndef QF633_CODE_BINARYFEEDER_H
+#define QF633_CODE_BINARYFEEDER_H
+
+#include <string>
+#include <functional>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "Msg.h"
+#include "MappedFile.h"
+#include "BinaryTickLog.h"
+
+// Replays a binary tick log (see BinaryTickLog.h) with the same Step()/listener contract as CsvFeeder
+class BinaryFeeder
+{
+public:
+    using FeedListener = std::function<void(const Msg &msg)>;
+    using TimerListener = std::function<void(uint64_t ms_now)>;
+    BinaryFeeder(const std::string ticker_filename,
+                 FeedListener feed_listener,
+                 std::chrono::minutes interval, TimerListener timer_listener);
+    bool Step();
+
+private:
+    bool ReadNext();
+
+    MappedFile file_;
+    FeedListener feed_listener_;
+    const std::chrono::milliseconds interval_;
+    TimerListener timer_listener_;
+
+    uint64_t now_ms_{};
+    Msg msg_;
+
+    const TickRecord* records_ = nullptr;
+    uint64_t num_records_ = 0;
+    uint64_t next_record_ = 0;
+    std::vector<instrument_id_t> instrument_ids_; // symbol table contract index to registry id
+    std::vector<uint32_t> index_ids_;             // symbol table underlying index to registry index id
+    std::vector<std::string> contract_names_;
+    std::vector<std::string> underlying_names_;
+};
+
+#endif // QF633_CODE_BINARYFEEDER_H
@@ -0,0 +1,134 @@
+#include "BinaryTickLog.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "CsvFeeder.h"
+
+bool IsBinaryTickLog(const std::string& filename)
+{
+    std::ifstream in(filename, std::ios::binary);
+    char magic[sizeof(BinaryTickLogMagic)] = {};
+    in.read(magic, sizeof(magic));
+    return in && std::memcmp(magic, BinaryTickLogMagic, sizeof(magic)) == 0;
+}
+
+namespace {
+
+// assigns file local indices to names in order of first appearance
+class SymbolTable
+{
+public:
+    uint32_t Index(const std::string& name)
+    {
+        auto it = index_.find(name);
+        if (it != index_.end()) {
+            return it->second;
+        }
+        names_.push_back(name);
+        index_.emplace(name, static_cast<uint32_t>(names_.size() - 1));
+        return static_cast<uint32_t>(names_.size() - 1);
+    }
+    const std::vector<std::string>& Names() const { return names_; }
+
+private:
+    std::unordered_map<std::string, uint32_t> index_;
+    std::vector<std::string> names_;
+};
+
+void WriteSymbols(std::ofstream& out, const std::vector<std::string>& names)
+{
+    for (const auto& name : names) {
+        if (name.size() > UINT16_MAX) {
+            throw std::invalid_argument("symbol too long for binary tick log: " + name.substr(0, 64));
+        }
+        const uint16_t len = static_cast<uint16_t>(name.size());
+        out.write(reinterpret_cast<const char*>(&len), sizeof(len));
+        out.write(name.data(), len);
+    }
+}
+
+} // namespace
+
+uint64_t ConvertCsvToBinaryTickLog(const std::string& csv_filename, const std::string& binary_filename)
+{
+    // the symbol table precedes the records but is only complete once the whole csv has been read,
+    // so records are spooled to a side file first and appended behind the header at the end
+    const std::string spool_filename = binary_filename + ".records";
+    std::ofstream spool(spool_filename, std::ios::binary | std::ios::trunc);
+    if (!spool) {
+        throw std::invalid_argument("cannot write " + spool_filename);
+    }
+
+    SymbolTable contracts;
+    SymbolTable underlyings;
+    uint64_t numRecords = 0;
+    auto feed_listener = [&](const Msg& msg) {
+        for (std::size_t i = 0; i < msg.Updates.size(); i++) {
+            const TickData& t = msg.Updates[i];
+            TickRecord r{};
+            r.LastUpdateTimeStamp = t.LastUpdateTimeStamp;
+            r.Contract = contracts.Index(InstrumentRegistry::Instance().Get(t.InstrumentId).Name);
+            const uint32_t underlying = underlyings.Index(InstrumentRegistry::Instance().IndexName(t.UnderlyingIndexId));
+            if (underlying > UINT16_MAX) {
+                throw std::invalid_argument("too many underlying indices for binary tick log");
+            }
+            r.Underlying = static_cast<uint16_t>(underlying);
+            r.Flags = (i == 0 ? TickRecordMsgBegin : 0) | (msg.isSnap ? TickRecordSnap : 0);
+            r.BestBidPrice = t.BestBidPrice;
+            r.BestBidAmount = t.BestBidAmount;
+            r.BestBidIV = t.BestBidIV;
+            r.BestAskPrice = t.BestAskPrice;
+            r.BestAskAmount = t.BestAskAmount;
+            r.BestAskIV = t.BestAskIV;
+            r.MarkPrice = t.MarkPrice;
+            r.MarkIV = t.MarkIV;
+            r.UnderlyingPrice = t.UnderlyingPrice;
+            r.LastPrice = t.LastPrice;
+            r.OpenInterest = t.OpenInterest;
+            spool.write(reinterpret_cast<const char*>(&r), sizeof(r));
+            numRecords++;
+        }
+    };
+    // the interval is irrelevant here, there is no timer listener
+    CsvFeeder csv_feeder(csv_filename, feed_listener, std::chrono::minutes(1), [](uint64_t) {});
+    while (csv_feeder.Step()) {
+    }
+    spool.close();
+
+    std::ofstream out(binary_filename, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::invalid_argument("cannot write " + binary_filename);
+    }
+    BinaryTickLogHeader header{};
+    std::memcpy(header.Magic, BinaryTickLogMagic, sizeof(header.Magic));
+    header.Version = BinaryTickLogVersion;
+    header.RecordSize = sizeof(TickRecord);
+    header.NumContracts = static_cast<uint32_t>(contracts.Names().size());
+    header.NumUnderlyings = static_cast<uint32_t>(underlyings.Names().size());
+    header.NumRecords = numRecords;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    WriteSymbols(out, contracts.Names());
+    WriteSymbols(out, underlyings.Names());
+
+    const uint64_t symbolsEnd = static_cast<uint64_t>(out.tellp());
+    header.RecordsOffset = (symbolsEnd + 63) / 64 * 64;
+    const std::vector<char> padding(header.RecordsOffset - symbolsEnd, 0);
+    out.write(padding.data(), padding.size());
+
+    std::ifstream records(spool_filename, std::ios::binary);
+    out << records.rdbuf();
+    records.close();
+    std::remove(spool_filename.c_str());
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!out) {
+        throw std::runtime_error("failed writing " + binary_filename);
+    }
+    return numRecords;
+}
@@ -0,0 +1,65 @@
+#ifndef QF633_CODE_BINARYTICKLOG_H
+#define QF633_CODE_BINARYTICKLOG_H
+
+#include <cstdint>
+#include <string>
+
+// Compact binary tick log, written once from a ticker csv and replayed by BinaryFeeder.
+//
+// Layout (native little-endian, no compression):
+//   BinaryTickLogHeader
+//   symbol table: NumContracts contract names, then NumUnderlyings underlying index names,
+//                 each as a uint16_t length followed by that many bytes (no terminator)
+//   zero padding up to RecordsOffset (a multiple of 64)
+//   NumRecords x TickRecord
+//
+// Records hold exactly the TickData fields of the csv rows, in the order the csv reader emitted them. Contract
+// and underlying names are replaced by indices into the symbol table. The message structure is kept in the
+// record flags, so a replay produces the same Msg stream as reading the csv.
+
+constexpr char BinaryTickLogMagic[8] = {'Q', 'F', '6', '3', '3', 'T', 'K', '1'};
+constexpr uint32_t BinaryTickLogVersion = 1;
+
+struct BinaryTickLogHeader {
+    char Magic[8];
+    uint32_t Version;
+    uint32_t RecordSize;     // sizeof(TickRecord), checked on load
+    uint32_t NumContracts;
+    uint32_t NumUnderlyings;
+    uint64_t NumRecords;
+    uint64_t RecordsOffset;  // file offset of the first TickRecord
+};
+
+enum TickRecordFlags : uint8_t {
+    TickRecordMsgBegin = 1, // first record of a Msg
+    TickRecordSnap = 2      // the Msg this record belongs to is a snapshot
+};
+
+struct TickRecord {
+    uint64_t LastUpdateTimeStamp;
+    uint32_t Contract;    // index into the contract names of the symbol table
+    uint16_t Underlying;  // index into the underlying names of the symbol table
+    uint8_t Flags;        // TickRecordFlags
+    uint8_t Reserved;
+    double BestBidPrice;
+    double BestBidAmount;
+    double BestBidIV;
+    double BestAskPrice;
+    double BestAskAmount;
+    double BestAskIV;
+    double MarkPrice;
+    double MarkIV;
+    double UnderlyingPrice;
+    double LastPrice;
+    double OpenInterest;
+    double Reserved2;     // keeps records at 112 bytes, a multiple of 16
+};
+static_assert(sizeof(TickRecord) == 112, "TickRecord layout is part of the file format");
+
+// true if the file starts with the binary tick log magic
+bool IsBinaryTickLog(const std::string& filename);
+
+// replays csv_filename through CsvFeeder and writes its Msg stream as a binary tick log, returns number of records
+uint64_t ConvertCsvToBinaryTickLog(const std::string& csv_filename, const std::string& binary_filename);
+
+#endif // QF633_CODE_BINARYTICKLOG_H
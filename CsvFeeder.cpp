@@ -1,8 +1,12 @@
 #include <iostream>
 #include "CsvFeeder.h"
+#include "FastParse.h"
+#include "LatencyStats.h"
+#include "Tracing.h"
 #include "date/date.h"
 
-uint64_t TimeToUnixMS(std::string ts) {
+// general parser, also used to validate the fast path in test_ts_parser
+uint64_t DateParseTimeToUnixMS(const std::string& ts) {
     std::istringstream in{ts};
     std::chrono::system_clock::time_point tp;
     in >> date::parse("%FT%T", tp);
@@ -10,92 +14,252 @@ uint64_t TimeToUnixMS(std::string ts) {
     return timestamp;
 }
 
-bool ReadNextMsg(std::ifstream& file, Msg& msg) {
-    if (file.eof()) {
-        return false;
+uint64_t TimeToUnixMS(const char* ts, std::size_t len) {
+    uint64_t timestamp;
+    if (ParseIsoTimestampMS(ts, len, timestamp)) {
+        return timestamp;
     }
-    // TODO: your implementation to read file and create the next Msg into the variable msg
+    return DateParseTimeToUnixMS(std::string(ts, len));
+}
 
-    std::string line;
-    std::vector<TickData> updates;
-    uint64_t lastUpdateTimeStamp = 0;
-    int counter = 0;
-    msg.isSet = true;
+uint64_t TimeToUnixMS(std::string ts) {
+    return TimeToUnixMS(ts.data(), ts.size());
+}
+
+// column layout of the ticker csv
+enum CsvColumn {
+    ContractNameCol = 0,
+    TimeCol = 1,
+    MsgTypeCol = 2,
+    BestBidPriceCol = 4,
+    BestBidAmountCol = 5,
+    BestBidIVCol = 6,
+    BestAskPriceCol = 7,
+    BestAskAmountCol = 8,
+    BestAskIVCol = 9,
+    MarkPriceCol = 10,
+    MarkIVCol = 11,
+    UnderlyingIndexCol = 12,
+    UnderlyingPriceCol = 13,
+    LastPriceCol = 15,
+    OpenInterestCol = 16,
+    NumCsvColumns = 17
+};
 
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string field;
+// line sources for ReadNextMsg: Peek() returns the current line without consuming it, Consume() moves to the next one
+struct StreamLines {
+    std::ifstream& file;
+    std::string& line;
+    bool& hasLine;
 
-        // Parse the CSV line and store each field in the 'field' variable
-        std::vector<std::string> fields;
-        while (std::getline(iss, field, ',')) {
-            fields.push_back(field);
+    bool Peek(std::string_view& out) {
+        if (!hasLine) {
+            if (!std::getline(file, line)) {
+                return false;
+            }
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            hasLine = true;
         }
+        out = line;
+        return true;
+    }
+    void Consume() { hasLine = false; }
+};
+
+struct MappedLines {
+    const char*& cursor;
+    const char* end;
+    std::string_view line{};
+    const char* next = nullptr;
+
+    bool Peek(std::string_view& out) {
+        if (next == nullptr) {
+            if (cursor >= end) {
+                return false;
+            }
+            next = cursor;
+            line = NextLine(next, end);
+        }
+        out = line;
+        return true;
+    }
+    void Consume() {
+        cursor = next;
+        next = nullptr;
+    }
+};
+
+// Reads all consecutive rows sharing one timestamp into msg. The first row of the following message is
+// peeked at but left unconsumed, so no row is lost at message boundaries.
+template <class LineSource>
+bool ReadNextMsg(LineSource& lines, Msg& msg) {
+    std::string_view line;
+    std::string_view fields[NumCsvColumns];
+    uint64_t lastUpdateTimeStamp = 0;
+    msg.Updates.clear();
+    msg.isSet = false;
+
+    while (lines.Peek(line)) {
+        if (line.empty()) {
+            lines.Consume();
+            continue;
+        }
+        SplitFields(line, fields, NumCsvColumns);
 
         // Discard first row (headers)
-        if (fields[0] == "contractName") {
+        if (fields[ContractNameCol] == "contractName") {
+            lines.Consume();
             continue;
         }
 
         // Discard any data before the first snapshot
-        if (fields[2] == "update" && msg.timestamp == 0) {
+        if (fields[MsgTypeCol] == "update" && msg.timestamp == 0) {
+            lines.Consume();
             continue;
         }
 
-        TickData update;
-        update.LastUpdateTimeStamp = TimeToUnixMS(fields[1]);
+        const uint64_t updateTimeStamp = TimeToUnixMS(fields[TimeCol].data(), fields[TimeCol].size());
 
-        // If the current timestamp is different from the previous one, return true
-        if (update.LastUpdateTimeStamp != lastUpdateTimeStamp && counter >= 1) {
-            msg.timestamp = update.LastUpdateTimeStamp;
-            msg.Updates = updates;
+        // If the current timestamp is different from the previous one, this row starts the next message
+        if (msg.isSet && updateTimeStamp != lastUpdateTimeStamp) {
             return true;
         }
+        lines.Consume();
 
         // Set the timestamp for the message
-        lastUpdateTimeStamp = update.LastUpdateTimeStamp;
-        msg.timestamp = update.LastUpdateTimeStamp;
+        lastUpdateTimeStamp = updateTimeStamp;
+        msg.timestamp = updateTimeStamp;
+        msg.isSet = true;
 
         // Determine if it's a snapshot
-        msg.isSnap = (fields[2] == "snap");
+        msg.isSnap = (fields[MsgTypeCol] == "snap");
 
         // Store data inside the TickData structure
-        update.ContractName = fields[0];
-        update.BestBidPrice = fields[4].empty() ? std::numeric_limits<double>::quiet_NaN() : std::stod(fields[4]);
-        update.BestBidAmount = fields[5].empty() ? std::numeric_limits<double>::quiet_NaN() : std::stod(fields[5]);
-        update.BestBidIV = fields[6].empty() ? std::numeric_limits<double>::quiet_NaN() : std::stod(fields[6]);
-        update.BestAskPrice = fields[7].empty() ? std::numeric_limits<double>::quiet_NaN() : std::stod(fields[7]);
-        update.BestAskAmount = fields[8].empty() ? std::numeric_limits<double>::quiet_NaN() : std::stod(fields[8]);
-        update.BestAskIV = fields[9].empty() ? std::numeric_limits<double>::quiet_NaN() : std::stod(fields[9]);
-        update.MarkPrice = fields[10].empty() ? std::numeric_limits<double>::quiet_NaN() : std::stod(fields[10]);
-        update.MarkIV = fields[11].empty() ? std::numeric_limits<double>::quiet_NaN() : std::stod(fields[11]);
-        update.UnderlyingIndex = fields[12];
-        update.UnderlyingPrice = fields[13].empty() ? std::numeric_limits<double>::quiet_NaN() : std::stod(fields[13]);
-        update.LastPrice = fields[15].empty() ? std::numeric_limits<double>::quiet_NaN() : std::stod(fields[15]);
-        update.OpenInterest = fields[16].empty() ? std::numeric_limits<double>::quiet_NaN() : std::stod(fields[16]);
-
-        updates.push_back(update);
-        counter++;
-    }
-
-    msg.timestamp = lastUpdateTimeStamp;
-    msg.Updates = updates;
-
-    return true;
+        TickData& update = msg.Updates.emplace_back();
+        update.LastUpdateTimeStamp = updateTimeStamp;
+        update.InstrumentId = InstrumentRegistry::Instance().Intern(fields[ContractNameCol]);
+        update.BestBidPrice = ParseDouble(fields[BestBidPriceCol]);
+        update.BestBidAmount = ParseDouble(fields[BestBidAmountCol]);
+        update.BestBidIV = ParseDouble(fields[BestBidIVCol]);
+        update.BestAskPrice = ParseDouble(fields[BestAskPriceCol]);
+        update.BestAskAmount = ParseDouble(fields[BestAskAmountCol]);
+        update.BestAskIV = ParseDouble(fields[BestAskIVCol]);
+        update.MarkPrice = ParseDouble(fields[MarkPriceCol]);
+        update.MarkIV = ParseDouble(fields[MarkIVCol]);
+        update.UnderlyingIndexId = InstrumentRegistry::Instance().InternIndex(fields[UnderlyingIndexCol]);
+        update.UnderlyingPrice = ParseDouble(fields[UnderlyingPriceCol]);
+        update.LastPrice = ParseDouble(fields[LastPriceCol]);
+        update.OpenInterest = ParseDouble(fields[OpenInterestCol]);
+    }
+
+    return msg.isSet;
+}
+
+// the row grouping of ReadNextMsg, reading only the time and msgType of each row
+std::vector<CsvMsgIndex> IndexCsvMessages(const std::string& ticker_filename) {
+    MappedFile file(ticker_filename);
+    std::vector<CsvMsgIndex> index;
+    const char* cursor = file.Data();
+    std::string_view fields[MsgTypeCol + 1];
+    while (cursor < file.End()) {
+        const std::size_t offset = cursor - file.Data();
+        const std::string_view line = NextLine(cursor, file.End());
+        if (line.empty()) {
+            continue;
+        }
+        SplitFields(line, fields, MsgTypeCol + 1);
+        if (fields[ContractNameCol] == "contractName" || (fields[MsgTypeCol] == "update" && index.empty())) {
+            continue;
+        }
+        const bool isSnap = fields[MsgTypeCol] == "snap";
+        const uint64_t timestamp = TimeToUnixMS(fields[TimeCol].data(), fields[TimeCol].size());
+        if (index.empty() || timestamp != index.back().timestamp) {
+            index.push_back({offset, timestamp, isSnap});
+        } else {
+            index.back().isSnap = index.back().isSnap && isSnap;
+        }
+    }
+    return index;
+}
+
+bool CsvFeeder::ReadNext(Msg &msg) {
+    QF633_PROFILE_STAGE(LatencyStage::ReadMsg);
+    QF633_TRACE_SCOPE("ReadNextMsg");
+    if (read_mode_ == CsvReadMode::MemoryMapped) {
+        MappedLines lines{cursor_, end_};
+        return ReadNextMsg(lines, msg);
+    }
+    StreamLines lines{ticker_file_, pending_line_, has_pending_line_};
+    return ReadNextMsg(lines, msg);
+}
+
+void CsvFeeder::ReaderLoop() {
+    try {
+        // every slot keeps its own msg.timestamp, the "before first snapshot" filter must see the last one read
+        uint64_t lastTimestamp = 0;
+        while (Msg *slot = ring_->BeginWrite()) {
+            slot->timestamp = lastTimestamp;
+            if (!ReadNext(*slot)) {
+                break;
+            }
+            lastTimestamp = slot->timestamp;
+            ring_->CommitWrite();
+        }
+    } catch (...) {
+        reader_error_ = std::current_exception();
+    }
+    ring_->Close();
 }
 
+bool CsvFeeder::NextFromRing() {
+    current_ = ring_->BeginRead();
+    if (current_ == nullptr && reader_error_) {
+        std::rethrow_exception(reader_error_);
+    }
+    return current_ != nullptr;
+}
 
 CsvFeeder::CsvFeeder(const std::string ticker_filename,
                      FeedListener feed_listener,
                      std::chrono::minutes interval,
-                     TimerListener timer_listener)
-        : ticker_file_(ticker_filename),
-          feed_listener_(feed_listener),
+                     TimerListener timer_listener,
+                     CsvReadMode read_mode,
+                     bool pipelined)
+        : feed_listener_(feed_listener),
           interval_(interval),
-          timer_listener_(timer_listener) {
+          timer_listener_(timer_listener),
+          read_mode_(read_mode) {
     // initialize member variables with input information, prepare for Step() processing
+    if (read_mode_ == CsvReadMode::MemoryMapped) {
+        mapped_file_ = std::make_unique<MappedFile>(ticker_filename);
+        cursor_ = mapped_file_->Data();
+        end_ = mapped_file_->End();
+    } else {
+        ticker_file_.open(ticker_filename);
+    }
 
-    ReadNextMsg(ticker_file_, msg_);
+    if (pipelined) {
+        ring_ = std::make_unique<SpscRing<Msg>>(RingSlots);
+        reader_ = std::thread(&CsvFeeder::ReaderLoop, this);
+        bool hasMsg;
+        try {
+            hasMsg = NextFromRing();
+        } catch (...) {
+            reader_.join();
+            throw;
+        }
+        if (!hasMsg) {
+            // the reader has closed the ring, so it is done
+            reader_.join();
+            throw std::invalid_argument("empty message at initialization");
+        }
+        now_ms_ = current_->timestamp;
+        return;
+    }
+
+    ReadNext(msg_);
     if (msg_.isSet) {
         // initialize interval timer now_ms_
         now_ms_ = msg_.timestamp;
@@ -104,7 +268,43 @@ CsvFeeder::CsvFeeder(const std::string ticker_filename,
     }
 }
 
+CsvFeeder::CsvFeeder(const std::string ticker_filename,
+                     FeedListener feed_listener,
+                     std::chrono::minutes interval,
+                     TimerListener timer_listener,
+                     const CsvFeedRange& range)
+        : feed_listener_(feed_listener),
+          interval_(interval),
+          timer_listener_(timer_listener),
+          read_mode_(CsvReadMode::MemoryMapped) {
+    mapped_file_ = std::make_unique<MappedFile>(ticker_filename);
+    if (range.begin > range.end || range.end > mapped_file_->Size()) {
+        throw std::invalid_argument(ticker_filename + ": replay range out of bounds");
+    }
+    cursor_ = mapped_file_->Data() + range.begin;
+    end_ = mapped_file_->Data() + range.end;
+    ReadNext(msg_);
+    if (!msg_.isSet) {
+        throw std::invalid_argument("empty message at initialization");
+    }
+    now_ms_ = range.now_ms;
+}
+
 bool CsvFeeder::Step() {
+    QF633_TRACE_SCOPE("CsvFeeder::Step");
+    if (ring_) {
+        if (current_ == nullptr) {
+            return false;
+        }
+        feed_listener_(*current_);
+        if (now_ms_ < current_->timestamp) {
+            timer_listener_(now_ms_);
+            now_ms_ += interval_.count();
+        }
+        ring_->EndRead();
+        return NextFromRing();
+    }
+
     if (msg_.isSet) {
         // call feed_listener with the loaded Msg
         feed_listener_(msg_);
@@ -116,13 +316,17 @@ bool CsvFeeder::Step() {
         }
         // load tick data into Msg
         // if there is no more message from the csv file, return false, otherwise true
-        return ReadNextMsg(ticker_file_, msg_);
+        return ReadNext(msg_);
     }
     return false;
 }
 
 CsvFeeder::~CsvFeeder() {
     // release resource allocated in constructor, if any
+    if (reader_.joinable()) {
+        ring_->Stop();
+        reader_.join();
+    }
     if (ticker_file_.is_open()) {
         ticker_file_.close();
     }
@@ -5,8 +5,41 @@
 #include <functional>
 #include <chrono>
 #include <fstream>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
 
 #include "Msg.h"
+#include "MappedFile.h"
+#include "SpscRing.h"
+
+// timestamps in the ticker file look like 2022-05-06T00:00:00.139Z; TimeToUnixMS takes a fixed-format fast path
+// and falls back to DateParseTimeToUnixMS (date::parse) for anything that does not match that layout
+uint64_t TimeToUnixMS(std::string ts);
+uint64_t TimeToUnixMS(const char* ts, std::size_t len);
+uint64_t DateParseTimeToUnixMS(const std::string& ts);
+
+// Stream reads the ticker file line by line through std::ifstream,
+// MemoryMapped maps the whole file and tokenizes the rows in place
+enum class CsvReadMode { Stream, MemoryMapped };
+
+// where a message starts in a ticker csv, see IndexCsvMessages
+struct CsvMsgIndex {
+    std::size_t offset;  // byte offset of its first row
+    uint64_t timestamp;
+    bool isSnap;         // every row of the message is a snap row
+};
+// the messages CsvFeeder would deliver from ticker_filename, in order, without parsing their contents
+std::vector<CsvMsgIndex> IndexCsvMessages(const std::string& ticker_filename);
+
+// part of a ticker csv to replay: the bytes [begin, end), starting at a message boundary, and the value of the
+// interval timer when the first message in it arrives
+struct CsvFeedRange {
+    std::size_t begin;
+    std::size_t end;
+    uint64_t now_ms;
+};
 
 class CsvFeeder
 {
@@ -15,8 +48,17 @@ public:
     using TimerListener = std::function<void(uint64_t ms_now)>;
     CsvFeeder(const std::string ticker_filename,
               FeedListener feed_listener,
-              std::chrono::minutes interval, TimerListener timer_listener);
+              std::chrono::minutes interval, TimerListener timer_listener,
+              CsvReadMode read_mode = CsvReadMode::MemoryMapped,
+              bool pipelined = false);
+    // replays only range, memory mapped and not pipelined
+    CsvFeeder(const std::string ticker_filename,
+              FeedListener feed_listener,
+              std::chrono::minutes interval, TimerListener timer_listener,
+              const CsvFeedRange& range);
     ~CsvFeeder();
+    CsvFeeder(const CsvFeeder &) = delete;
+    CsvFeeder &operator=(const CsvFeeder &) = delete;
     bool Step();
 
 private:
@@ -28,7 +70,26 @@ private:
     uint64_t now_ms_{};
     Msg msg_;
     // your member variables and member functions below, if any
-    std::vector<std::string> titles;
+    bool ReadNext(Msg &msg);
+
+    const CsvReadMode read_mode_;
+    // Stream mode: the first row of the next message, read ahead while looking for the end of the current one
+    std::string pending_line_;
+    bool has_pending_line_ = false;
+    // MemoryMapped mode: the mapped file and the read position in it
+    std::unique_ptr<MappedFile> mapped_file_;
+    const char* cursor_ = nullptr;
+    const char* end_ = nullptr;
+
+    // Pipelined mode: a reader thread parses ahead into ring_, Step() consumes the slots in order on the calling
+    // thread, so listeners still run on the caller and in the same order as the serial mode
+    void ReaderLoop();
+    bool NextFromRing();
+    static constexpr std::size_t RingSlots = 64;
+    std::unique_ptr<SpscRing<Msg>> ring_;
+    std::thread reader_;
+    std::exception_ptr reader_error_;
+    const Msg *current_ = nullptr; // slot being delivered, nullptr when the ring is drained
 };
 
 #endif // QF633_CODE_CSVFEEDER_H
@@ -1,137 +1,291 @@
 #include "CubicSmile.h"
 #include "BSAnalytics.h"
+#include "Dual.h"
+#include "SimdMath.h"
 #include <cmath>
 #include <iostream>
 #include <algorithm>
 #include <cmath>
-#include <map>
-#include <time.h>
-#include <errno.h>
-#include <cstring>
 
-double GetStrike(const std::string &cName)
+namespace
 {
-    std::size_t pos = 0;
-    pos = cName.find('-', pos);
-    pos = cName.find('-', pos + 1) + 1;
-    std::size_t pos_end = cName.find('-', pos);
-    return std::stod(cName.substr(pos, pos_end - pos));
+constexpr int NumMarks = 5;
+
+// the strike and vol marks at quick deltas 0.9, 0.75, 0.5 (the forward), 0.25 and 0.1 for the smile parameters
+// p = {atmvol, bf25, rr25, bf10, rr10}; S is double, or Dual to carry the gradient with respect to p
+template <class S>
+void DeltaMarks(double fwd, double T, const S (&p)[5], S (&k)[NumMarks], S (&v)[NumMarks])
+{
+    const S &atmvol = p[0], &bf25 = p[1], &rr25 = p[2], &bf10 = p[3], &rr10 = p[4];
+    v[0] = atmvol + bf10 - rr10 / 2.0;
+    v[1] = atmvol + bf25 - rr25 / 2.0;
+    v[2] = atmvol;
+    v[3] = atmvol + bf25 + rr25 / 2.0;
+    v[4] = atmvol + bf10 + rr10 / 2.0;
+
+    // we use quick delta: qd = N(log(F/K / (atmvol) / sqrt(T)), so K = F / exp((N^{-1}(qd) * stdev))
+    static const double inv[NumMarks] = {invcnorm(0.9), invcnorm(0.75), 0, invcnorm(0.25), invcnorm(0.1)};
+    const S stdev = atmvol * sqrt(T);
+    for (int i = 0; i < NumMarks; i++)
+        k[i] = i == 2 ? S(fwd) : fwd / exp(inv[i] * stdev);
 }
 
-time_t GetExpiryTime(std::string expiry)
+template <class S>
+struct SplinePiece
+{
+    S origin, c0, c1, c2, c3;
+};
+
+// cubic spline through the marks (k[i], v[i]) with zero end slopes, as pieces c0 + c1 t + c2 t^2 + c3 t^3 in
+// t = strike - origin. pieces[i] applies below k[i], pieces[NumMarks] above the last mark; both ends are flat.
+template <class S>
+void SplinePieces(const S (&k)[NumMarks], const S (&v)[NumMarks], SplinePiece<S> (&pieces)[NumMarks + 1])
 {
-    static std::map<std::string, int> months = {
-            {"JAN", 1},
-            {"FEB", 2},
-            {"MAR", 3},
-            {"APR", 4},
-            {"MAY", 5},
-            {"JUN", 6},
-            {"JUL", 7},
-            {"AUG", 8},
-            {"SEP", 9},
-            {"OCT", 10},
-            {"NOV", 11},
-            {"DEC", 12}};
-
-    int splitPos = expiry.find('-') + 1;
-    expiry = expiry.substr(splitPos, expiry.length() - splitPos);
-    splitPos = expiry.find('-');
-    expiry = expiry.substr(0, splitPos);
-    int y, m, d;
-    if (expiry.length() == 6)
+    const int n = NumMarks;
+    // end y' are zero, flat extrapolation
+    const double yp1 = 0;
+    const double ypn = 0;
+    S y2[NumMarks], u[NumMarks - 1];
+
+    y2[0] = -0.5;
+    u[0] = (3.0 / (k[1] - k[0])) * ((v[1] - v[0]) / (k[1] - k[0]) - yp1);
+
+    for (int i = 1; i < n - 1; i++)
     {
-        d = std::stoi(expiry.substr(0, 1));
-        m = months[expiry.substr(1, 3)];
-        y = stoi(expiry.substr(4, 2));
+        S sig = (k[i] - k[i - 1]) / (k[i + 1] - k[i - 1]);
+        S p = sig * y2[i - 1] + 2.0;
+        y2[i] = (sig - 1.0) / p;
+        u[i] = (v[i + 1] - v[i]) / (k[i + 1] - k[i]) - (v[i] - v[i - 1]) / (k[i] - k[i - 1]);
+        u[i] = (6.0 * u[i] / (k[i + 1] - k[i - 1]) - sig * u[i - 1]) / p;
     }
-    else if (expiry.length() == 7)
+
+    const double qn = 0.5;
+    S un = (3.0 / (k[n - 1] - k[n - 2])) * (ypn - (v[n - 1] - v[n - 2]) / (k[n - 1] - k[n - 2]));
+
+    y2[n - 1] = (un - qn * u[n - 2]) / (qn * y2[n - 2] + 1.0);
+
+    for (int i = n - 2; i >= 0; i--)
     {
-        d = std::stoi(expiry.substr(0, 2));
-        m = months[expiry.substr(2, 3)];
-        y = stoi(expiry.substr(5, 2));
+        y2[i] = y2[i] * y2[i + 1] + u[i];
     }
-    else
+
+    // expand each spline piece into a cubic in (strike - left mark)
+    pieces[0] = {k[0], v[0], S(0), S(0), S(0)};
+    for (int i = 1; i < n; i++)
     {
-        std::cerr << "Invalid expiry " << expiry << std::endl;
-        exit(-1);
+        S h = k[i] - k[i - 1];
+        pieces[i].origin = k[i - 1];
+        pieces[i].c0 = v[i - 1];
+        pieces[i].c1 = (v[i] - v[i - 1]) / h - h * (2.0 * y2[i - 1] + y2[i]) / 6.0;
+        pieces[i].c2 = y2[i - 1] / 2.0;
+        pieces[i].c3 = (y2[i] - y2[i - 1]) / (6.0 * h);
     }
+    pieces[n] = {k[n - 1], v[n - 1], S(0), S(0), S(0)};
+}
 
-    struct tm time;
-    time.tm_year = y + 100;
-    time.tm_mon = m - 1;
-    time.tm_mday = d;
-    time.tm_hour = time.tm_min = time.tm_sec = 0;
-    time.tm_isdst = 0;
+// the smile at one strike, same segment rule as CubicSmile::Vol
+template <class S>
+S EvalPieces(const S (&k)[NumMarks], const SplinePiece<S> (&pieces)[NumMarks + 1], double strike)
+{
+    int i = 0;
+    while (i < NumMarks && !(strike < Value(k[i])))
+        i++;
+    const SplinePiece<S> &piece = pieces[i];
+    const S t = strike - piece.origin;
+    return ((piece.c3 * t + piece.c2) * t + piece.c1) * t + piece.c0;
+}
+
+using Grad = Dual<5>;
 
-    auto res = mktime(&time);
-    if (res == time_t(-1))
+// weighted sum of squared residuals w (vol - iv) at parameters p, with the Gauss-Newton normal matrix JtJ and Jtr
+double Residuals(double fwd, double T, const double (&p)[5], const std::vector<double> &strike, const std::vector<double> &iv,
+                 const std::vector<double> &weight, double (&JtJ)[5][5], double (&Jtr)[5])
+{
+    Grad params[5], k[NumMarks], v[NumMarks];
+    SplinePiece<Grad> pieces[NumMarks + 1];
+    for (int j = 0; j < 5; j++)
+        params[j] = Grad::Variable(p[j], j);
+    DeltaMarks(fwd, T, params, k, v);
+    SplinePieces(k, v, pieces);
+
+    double cost = 0;
+    for (int a = 0; a < 5; a++)
+    {
+        Jtr[a] = 0;
+        for (int b = 0; b < 5; b++)
+            JtJ[a][b] = 0;
+    }
+    for (std::size_t i = 0; i < strike.size(); i++)
+    {
+        const Grad vol = EvalPieces(k, pieces, strike[i]);
+        const double r = weight[i] * (vol.v - iv[i]);
+        cost += r * r;
+        for (int a = 0; a < 5; a++)
+        {
+            const double ja = weight[i] * vol.d[a];
+            Jtr[a] += ja * r;
+            for (int b = 0; b <= a; b++)
+                JtJ[a][b] += ja * weight[i] * vol.d[b];
+        }
+    }
+    for (int a = 0; a < 5; a++)
+        for (int b = a + 1; b < 5; b++)
+            JtJ[a][b] = JtJ[b][a];
+    return cost;
+}
+
+// solves A x = b for symmetric positive definite A by Cholesky; false if A is not
+bool SolveSpd(double (&A)[5][5], const double (&b)[5], double (&x)[5])
+{
+    for (int j = 0; j < 5; j++)
+    {
+        double d = A[j][j];
+        for (int m = 0; m < j; m++)
+            d -= A[j][m] * A[j][m];
+        if (!(d > 0))
+            return false;
+        A[j][j] = std::sqrt(d);
+        for (int i = j + 1; i < 5; i++)
+        {
+            double s = A[i][j];
+            for (int m = 0; m < j; m++)
+                s -= A[i][m] * A[j][m];
+            A[i][j] = s / A[j][j];
+        }
+    }
+    for (int i = 0; i < 5; i++)
+    {
+        double s = b[i];
+        for (int m = 0; m < i; m++)
+            s -= A[i][m] * x[m];
+        x[i] = s / A[i][i];
+    }
+    for (int i = 4; i >= 0; i--)
     {
-        std::cout << std::strerror(errno) << std::endl;
-        exit(0);
+        double s = x[i];
+        for (int m = i + 1; m < 5; m++)
+            s -= A[m][i] * x[m];
+        x[i] = s / A[i][i];
     }
-    return res;
+    return true;
 }
+} // namespace
 
-CubicSmile CubicSmile::FitSmile(const std::vector<TickData> &volTickerSnap)
+CubicSmile CubicSmile::FitSmile(const ExpiryQuotes &quotes, const CubicSmile *previous)
 {
-    double fwd, T, atmvol, bf25, rr25, bf10, rr10;
-    // TODO (step 3): fit a CubicSmile that is close to the raw tickers
+    double fwd, T;
 
-    // - make sure all tickData are on the same expiry and same underlying
+    // - get latest underlying price from all tickers based on LastUpdateTimeStamp
     uint64_t lastTime = 0;
-    int index = 0;
+    std::size_t index = 0;
+    const uint64_t *updateTime = quotes.LastUpdateTimeStamp.data();
+    for (std::size_t i = 0; i < quotes.Size(); i++)
+    {
+        if (updateTime[i] > lastTime)
+        {
+            lastTime = updateTime[i];
+            index = i;
+        }
+    }
+    fwd = quotes.UnderlyingPrice[index];
+    const int64_t expiryTime = quotes.ExpiryTimeMS;
+    const int64_t curTime = quotes.LastUpdateTimeStamp[index];
 
-    for (const auto& volSnap : volTickerSnap)
+    // - get time to expiry T, ACT/365
+    T = std::max(1e-6, YearFraction(expiryTime - curTime));
+
+    // - the observations: mid of bid and ask IV weighted by the inverse spread where both sides are quoted, the mark IV
+    //   with a low weight otherwise. Buffers are per thread, expiries may be fitted concurrently.
+    thread_local std::vector<double> strike, iv, weight;
+    strike.clear();
+    iv.clear();
+    weight.clear();
+    std::size_t atm = 0;
+    for (std::size_t i = 0; i < quotes.Size(); i++)
     {
-        if (volSnap.LastUpdateTimeStamp > lastTime)
+        const double bid = quotes.BestBidIV[i] / 100, ask = quotes.BestAskIV[i] / 100, mark = quotes.MarkIV[i] / 100;
+        if (bid > 0 && ask >= bid)
+        {
+            iv.push_back((bid + ask) / 2);
+            weight.push_back(1 / std::max(ask - bid, 0.005));
+        }
+        else if (mark > 0)
         {
-            lastTime = volSnap.LastUpdateTimeStamp;
-            index = &volSnap - &volTickerSnap[0];
+            iv.push_back(mark);
+            weight.push_back(1 / 0.05);
         }
+        else
+            continue;
+        strike.push_back(quotes.Strike[i]);
+        if (std::fabs(strike.back() - fwd) < std::fabs(strike[atm] - fwd))
+            atm = strike.size() - 1;
     }
+    if (strike.empty())
+        return CubicSmile(fwd, T, std::max(quotes.MarkIV[index] / 100, 1e-4), 0, 0, 0, 0);
 
-    // - get latest underlying price from all tickers based on LastUpdateTimeStamp
-    const auto& volSnap = volTickerSnap[index];
-    fwd = volSnap.UnderlyingPrice;
-    double expiryTime = GetExpiryTime(volSnap.ContractName) * 1000;
-    double curTime = volSnap.LastUpdateTimeStamp;
-
-
-    // - get time to expiry T
-    T = std::max(1e-6, (expiryTime - curTime) / 3.1536e10);
-    //T = (((expiryTime - curTime) + (2.88e7)) / 3.1536e10);
-    //T = ((expiryTime - curTime) + (23 * 60 * 60 * 1000) + (59 * 60 * 1000))/ 3.1536e10;
-
-    // - fit the 5 parameters of the smile, atmvol, bf25, rr25, bf10, and rr10 using L-BFGS-B solver, to the ticker data
-    double iv = impliedVol(Call, GetStrike(volTickerSnap[index].ContractName), fwd, T, volTickerSnap[index].BestBidPrice * fwd);
-    double undiscPrice = bsUndisc(Call, fwd, fwd, T, iv);
-    atmvol = impliedVol(Call, fwd, fwd, T, undiscPrice);
-    double mIV = volTickerSnap[index].MarkIV / 200;
-    if (atmvol == 0.0001) {
-        atmvol = mIV;
+    // - fit the 5 parameters of the smile, atmvol, bf25, rr25, bf10, and rr10, by weighted least squares
+    //   (Levenberg-Marquardt, gradients by forward-mode differentiation through the spline). Start from the previous
+    //   fit of this expiry when there is one, otherwise from a flat smile at the vol quoted nearest the forward.
+    double p[5] = {iv[atm], 0, 0, 0, 0};
+    if (previous && previous->params.size() == 6 && previous->params[1] > 0 && std::isfinite(previous->params[1]))
+        std::copy(previous->params.begin() + 1, previous->params.end(), p);
+
+    double JtJ[5][5], Jtr[5];
+    double cost = Residuals(fwd, T, p, strike, iv, weight, JtJ, Jtr);
+    double lambda = 1e-3;
+    for (int iter = 0; iter < 100 && cost > 0; iter++)
+    {
+        // damped normal equations (JtJ + lambda diag(JtJ)) step = -Jtr
+        double A[5][5], minusJtr[5], step[5];
+        for (int a = 0; a < 5; a++)
+        {
+            for (int b = 0; b < 5; b++)
+                A[a][b] = JtJ[a][b];
+            A[a][a] += lambda * JtJ[a][a] + 1e-12;
+            minusJtr[a] = -Jtr[a];
+        }
+        if (!SolveSpd(A, minusJtr, step))
+        {
+            lambda *= 10;
+            continue;
+        }
+        double trial[5], stepSize = 0;
+        for (int a = 0; a < 5; a++)
+        {
+            trial[a] = p[a] + step[a];
+            stepSize = std::max(stepSize, std::fabs(step[a]));
+        }
+        trial[0] = std::max(trial[0], 1e-4); // keep the quick-delta strikes ordered
+        if (stepSize < 1e-8)
+            break;
+
+        double trialJtJ[5][5], trialJtr[5];
+        const double trialCost = Residuals(fwd, T, trial, strike, iv, weight, trialJtJ, trialJtr);
+        if (trialCost < cost)
+        {
+            const bool converged = cost - trialCost <= 1e-8 * cost;
+            std::copy(trial, trial + 5, p);
+            std::copy(&trialJtJ[0][0], &trialJtJ[0][0] + 25, &JtJ[0][0]);
+            std::copy(trialJtr, trialJtr + 5, Jtr);
+            cost = trialCost;
+            lambda = std::max(lambda / 3, 1e-12);
+            if (converged)
+                break;
+        }
+        else
+        {
+            lambda *= 4;
+            if (lambda > 1e12)
+                break;
+        }
     }
-    double stdev = atmvol * sqrt(T);
-
-    double k_qd90 = quickDeltaToStrike(0.9, fwd, stdev);
-    double k_qd75 = quickDeltaToStrike(0.75, fwd, stdev);
-    double k_qd25 = quickDeltaToStrike(0.25, fwd, stdev);
-    double k_qd10 = quickDeltaToStrike(0.1, fwd, stdev);
-
-    double v_qd90 = impliedVol(Call, k_qd90, fwd, T, undiscPrice + fwd - k_qd90);
-    double v_qd75 = impliedVol(Call, k_qd75, fwd, T, undiscPrice + fwd - k_qd75);
-    double v_qd25 = impliedVol(Put, k_qd25, fwd, T, undiscPrice + k_qd25 - fwd);
-    double v_qd10 = impliedVol(Put, k_qd10, fwd, T, undiscPrice + k_qd10 - fwd);
-    bf25 = (v_qd25 + v_qd75) / 2 - atmvol;
-    rr25 = v_qd25 - v_qd75;
-    bf10 = (v_qd10 + v_qd90) / 2 - atmvol;
-    rr10 = v_qd10 - v_qd90;
 
     // after the fitting, we can return the resulting smile
-    return CubicSmile(fwd, T, atmvol, bf25, rr25, bf10, rr10);
+    return CubicSmile(fwd, T, p[0], p[1], p[2], p[3], p[4]);
 }
 
 CubicSmile::CubicSmile(double underlyingPrice, double T, double atmvol, double bf25, double rr25, double bf10, double rr10)
+    : timeToExpiry(T)
 {
     // save parameters
     params.push_back(underlyingPrice);
@@ -141,80 +295,61 @@ CubicSmile::CubicSmile(double underlyingPrice, double T, double atmvol, double b
     params.push_back(bf10);
     params.push_back(rr10);
 
-    // convert delta marks to strike vol marks, setup strikeMarks, then call BUildInterp
-    double v_qd90 = atmvol + bf10 - rr10 / 2.0;
-    double v_qd75 = atmvol + bf25 - rr25 / 2.0;
-    double v_qd25 = atmvol + bf25 + rr25 / 2.0;
-    double v_qd10 = atmvol + bf10 + rr10 / 2.0;
-
-    // we use quick delta: qd = N(log(F/K / (atmvol) / sqrt(T))
-    double stdev = atmvol * sqrt(T);
-    double k_qd90 = quickDeltaToStrike(0.9, underlyingPrice, stdev);
-    double k_qd75 = quickDeltaToStrike(0.75, underlyingPrice, stdev);
-    double k_qd25 = quickDeltaToStrike(0.25, underlyingPrice, stdev);
-    double k_qd10 = quickDeltaToStrike(0.1, underlyingPrice, stdev);
-
-    strikeMarks.push_back(std::pair<double, double>(k_qd90, v_qd90));
-    strikeMarks.push_back(std::pair<double, double>(k_qd75, v_qd75));
-    strikeMarks.push_back(std::pair<double, double>(underlyingPrice, atmvol));
-    strikeMarks.push_back(std::pair<double, double>(k_qd25, v_qd25));
-    strikeMarks.push_back(std::pair<double, double>(k_qd10, v_qd10));
+    // convert delta marks to strike vol marks, setup strikeMarks, then call BuildInterp
+    const double p[5] = {atmvol, bf25, rr25, bf10, rr10};
+    double k[NumMarks], v[NumMarks];
+    DeltaMarks(underlyingPrice, T, p, k, v);
+    for (int i = 0; i < NumMarks; i++)
+        strikeMarks.push_back(std::pair<double, double>(k[i], v[i]));
     BuildInterp();
 }
 
 void CubicSmile::BuildInterp()
 {
-    int n = strikeMarks.size();
-    // end y' are zero, flat extrapolation
-    double yp1 = 0;
-    double ypn = 0;
-    y2.resize(n);
-    vector<double> u(n - 1);
-
-    y2[0] = -0.5;
-    u[0] = (3.0 / (strikeMarks[1].first - strikeMarks[0].first)) *
-           ((strikeMarks[1].second - strikeMarks[0].second) / (strikeMarks[1].first - strikeMarks[0].first) - yp1);
-
-    for (int i = 1; i < n - 1; i++)
+    double k[NumMarks], v[NumMarks];
+    for (int i = 0; i < NumMarks; i++)
     {
-        double sig = (strikeMarks[i].first - strikeMarks[i - 1].first) / (strikeMarks[i + 1].first - strikeMarks[i - 1].first);
-        double p = sig * y2[i - 1] + 2.0;
-        y2[i] = (sig - 1.0) / p;
-        u[i] = (strikeMarks[i + 1].second - strikeMarks[i].second) / (strikeMarks[i + 1].first - strikeMarks[i].first) - (strikeMarks[i].second - strikeMarks[i - 1].second) / (strikeMarks[i].first - strikeMarks[i - 1].first);
-        u[i] = (6.0 * u[i] / (strikeMarks[i + 1].first - strikeMarks[i - 1].first) - sig * u[i - 1]) / p;
+        k[i] = strikeMarks[i].first;
+        v[i] = strikeMarks[i].second;
     }
+    SplinePiece<double> pieces[NumMarks + 1];
+    SplinePieces(k, v, pieces);
+    segments.clear();
+    for (const SplinePiece<double> &piece : pieces)
+        segments.push_back({piece.origin, piece.c0, piece.c1, piece.c2, piece.c3});
+}
 
-    double qn = 0.5;
-    double un = (3.0 / (strikeMarks[n - 1].first - strikeMarks[n - 2].first)) *
-                (ypn - (strikeMarks[n - 1].second - strikeMarks[n - 2].second) / (strikeMarks[n - 1].first - strikeMarks[n - 2].first));
-
-    y2[n - 1] = (un - qn * u[n - 2]) / (qn * y2[n - 2] + 1.0);
-
-    for (int i = n - 2; i >= 0; i--)
+template <class Ops>
+typename Ops::V CubicSmile::Vol(typename Ops::V strike) const
+{
+    // pick the segment of the first mark above the strike without branching: walk the marks from the right,
+    // keeping the segment below each mark the strike is under
+    const Segment *last = &segments.back();
+    typename Ops::V origin = Ops::Set1(last->origin), c0 = Ops::Set1(last->c0), c1 = Ops::Set1(last->c1),
+                    c2 = Ops::Set1(last->c2), c3 = Ops::Set1(last->c3);
+    for (std::size_t i = strikeMarks.size(); i-- > 0;)
     {
-        y2[i] = y2[i] * y2[i + 1] + u[i];
+        const auto below = Ops::Lt(strike, Ops::Set1(strikeMarks[i].first));
+        const Segment &s = segments[i];
+        origin = Ops::Select(below, Ops::Set1(s.origin), origin);
+        c0 = Ops::Select(below, Ops::Set1(s.c0), c0);
+        c1 = Ops::Select(below, Ops::Set1(s.c1), c1);
+        c2 = Ops::Select(below, Ops::Set1(s.c2), c2);
+        c3 = Ops::Select(below, Ops::Set1(s.c3), c3);
     }
+    const typename Ops::V t = Ops::Sub(strike, origin);
+    return Ops::Fma(Ops::Fma(Ops::Fma(c3, t, c2), t, c1), t, c0);
+}
+
+double CubicSmile::Vol(double strike) const
+{
+    return Vol<simd::ScalarOps>(strike);
 }
 
-double CubicSmile::Vol(double strike)
+void CubicSmile::Vol(const double *strikes, double *out, std::size_t n) const
 {
-    unsigned i;
-    // we use trivial search, but can consider binary search for better performance
-    for (i = 0; i < strikeMarks.size(); i++)
-        if (strike < strikeMarks[i].first)
-            break; // i stores the index of the right end of the bracket
-
-    // extrapolation
-    if (i == 0)
-        return strikeMarks[i].second;
-    if (i == strikeMarks.size())
-        return strikeMarks[i - 1].second;
-
-    // interpolate
-    double h = strikeMarks[i].first - strikeMarks[i - 1].first;
-    double a = (strikeMarks[i].first - strike) / h;
-    double b = 1 - a;
-    double c = (a * a * a - a) * h * h / 6.0;
-    double d = (b * b * b - b) * h * h / 6.0;
-    return a * strikeMarks[i - 1].second + b * strikeMarks[i].second + c * y2[i - 1] + d * y2[i];
+    simd::ForEachBlock(n, [&](auto ops, std::size_t i) {
+        using Ops = decltype(ops);
+        Ops::Store(out + i, Vol<Ops>(Ops::Load(strikes + i)));
+    });
 }
\ No newline at end of file
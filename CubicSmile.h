@@ -1,9 +1,10 @@
 #ifndef _CUBICSMILE_H
 #define _CUBICSMILE_H
 
+#include <cstddef>
 #include <vector>
 #include <utility>
-#include "Msg.h"
+#include "QuoteStore.h"
 
 using namespace std;
 
@@ -11,17 +12,31 @@ using namespace std;
 class CubicSmile
 {
 public:
-  static CubicSmile FitSmile(const std::vector<TickData> &); // FitSmile creates a Smile by fitting the smile params to the input tick data, it assume the tickData are of the same expiry
+  // FitSmile creates a Smile by fitting the smile params to the quotes of one expiry, starting from previous if given
+  // (typically the last fit of the same expiry)
+  static CubicSmile FitSmile(const ExpiryQuotes &, const CubicSmile *previous = nullptr);
   // constructor, given the underlying price and marks, convert them to strike to vol pairs (strikeMarks), and construct cubic smile
   CubicSmile(double underlyingPrice, double T, double atmvol, double bf25, double rr25, double bf10, double rr10); // convert parameters to strikeMarks, then call BuildInterp() to create the cubic spline interpolator
-  double Vol(double strike);                                                                                       // interpolate
+  double Vol(double strike) const;                                                                                 // interpolate
+  void Vol(const double *strikes, double *out, std::size_t n) const;                                               // out[i] = Vol(strikes[i]), vectorized
+  double Forward() const { return params[0]; }
+  double TimeToExpiry() const { return timeToExpiry; } // in years, as of the fit
   vector<double> params;
 
 private:
   void BuildInterp();
+  template <class Ops>
+  typename Ops::V Vol(typename Ops::V strike) const;
+  double timeToExpiry;
   // strike to implied vol marks
   vector<pair<double, double>> strikeMarks;
-  vector<double> y2; // second derivatives
+  // Vol = c0 + c1 t + c2 t^2 + c3 t^3 with t = strike - origin. segments[i] applies below strikeMarks[i].first,
+  // segments.back() above the last mark; the two ends are constant for flat extrapolation.
+  struct Segment
+  {
+    double origin, c0, c1, c2, c3;
+  };
+  vector<Segment> segments;
 };
 
 #endif
@@ -1,33 +1,87 @@
 #ifndef QF633_DATE_H
 #define QF633_DATE_H
 
+#include <cstdint>
 #include <iostream>
-#include <ctime>
 
-class datetime_t { // hold date[time] (interpreted as UTC)
+// Proleptic Gregorian calendar to and from days since 1970-01-01 (H. Hinnant's days_from_civil / civil_from_days)
+constexpr int64_t DaysFromCivil(int64_t y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);            // [0, 399]
+    const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1; // [0, 365]
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;           // [0, 146096]
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+struct CivilDate {
+    int64_t year;
+    unsigned month; // 1..12
+    unsigned day;   // 1..31
+};
+
+constexpr CivilDate CivilFromDays(int64_t z)
+{
+    z += 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);               // [0, 146096]
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365; // [0, 399]
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);               // [0, 365]
+    const unsigned mp = (5 * doy + 2) / 153;                                    // [0, 11]
+    const unsigned d = doy - (153 * mp + 2) / 5 + 1;
+    const unsigned m = mp < 10 ? mp + 3 : mp - 9;
+    return {static_cast<int64_t>(yoe) + era * 400 + (m <= 2), m, d};
+}
+
+constexpr bool IsLeapYear(int64_t y) { return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0; }
+
+constexpr unsigned DaysInMonth(int64_t y, unsigned m)
+{
+    constexpr unsigned days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return m == 2 && IsLeapYear(y) ? 29 : days[m - 1];
+}
+
+constexpr int64_t MsPerDay = 86400000;
+constexpr int64_t MsPerYear = 365 * MsPerDay; // ACT/365
+
+// milliseconds as a year fraction, ACT/365
+constexpr double YearFraction(int64_t ms) { return ms / static_cast<double>(MsPerYear); }
+
+// floor(a / b) for b > 0
+constexpr int64_t FloorDiv(int64_t a, int64_t b) { return a / b - (a % b < 0); }
+
+class datetime_t { // hold date[time] (interpreted as UTC) as milliseconds since the unix epoch
 public:
-    int year;
-    int month;
-    int day;
-    int hour = 0;
-    int min = 0;
-    int sec = 0;
-    datetime_t(int y, int m, int d, int hour_ = 0, int min_ = 0, int sec_ = 0) : year(y), month(m), day(d), hour(hour_), min(min_), sec(sec_) {};
-    datetime_t(){}
-    datetime_t(uint64_t unix_epoch_sec) {
-        const time_t second = unix_epoch_sec;
-        auto tm = std::gmtime(&second);
-        year = tm->tm_year;
-        month = tm->tm_mon;
-        day = tm->tm_mday;
-        hour = tm->tm_hour;
-        min = tm->tm_min;
-        sec = tm->tm_sec;
+    constexpr datetime_t() = default;
+    constexpr datetime_t(int y, int m, int d, int hour = 0, int min = 0, int sec = 0)
+        : ms_(DaysFromCivil(y, m, d) * MsPerDay + ((hour * 60LL + min) * 60 + sec) * 1000) {}
+    static constexpr datetime_t FromUnixMS(int64_t ms)
+    {
+        datetime_t t;
+        t.ms_ = ms;
+        return t;
     }
+
+    constexpr int64_t UnixMS() const { return ms_; }
+    constexpr int64_t DaysSinceEpoch() const { return FloorDiv(ms_, MsPerDay); }
+    constexpr int Year() const { return static_cast<int>(CivilFromDays(DaysSinceEpoch()).year); }
+    constexpr int Month() const { return static_cast<int>(CivilFromDays(DaysSinceEpoch()).month); }
+    constexpr int Day() const { return static_cast<int>(CivilFromDays(DaysSinceEpoch()).day); }
+    constexpr int Hour() const { return static_cast<int>(MsOfDay() / 3600000); }
+    constexpr int Min() const { return static_cast<int>(MsOfDay() / 60000 % 60); }
+    constexpr int Sec() const { return static_cast<int>(MsOfDay() / 1000 % 60); }
+
+private:
+    constexpr int64_t MsOfDay() const { return ms_ - DaysSinceEpoch() * MsPerDay; }
+    int64_t ms_ = 0;
 };
 
-double operator-(const datetime_t& d1, const datetime_t& d2);
-bool operator<(const datetime_t& d1, const datetime_t& d2);
+// d1 - d2 in years, ACT/365
+constexpr double operator-(const datetime_t& d1, const datetime_t& d2) { return YearFraction(d1.UnixMS() - d2.UnixMS()); }
+constexpr bool operator<(const datetime_t& d1, const datetime_t& d2) { return d1.UnixMS() < d2.UnixMS(); }
+constexpr bool operator==(const datetime_t& d1, const datetime_t& d2) { return d1.UnixMS() == d2.UnixMS(); }
+constexpr bool operator!=(const datetime_t& d1, const datetime_t& d2) { return !(d1 == d2); }
 std::ostream& operator<<(std::ostream& os, const datetime_t& date);
 std::istream& operator>>(std::istream& is, datetime_t& date);
 
@@ -0,0 +1,109 @@
+#ifndef QF633_CODE_DUAL_H
+#define QF633_CODE_DUAL_H
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+// Forward-mode automatic differentiation: a value together with its gradient with respect to N inputs.
+// Code templated on the number type runs on double for values and on Dual<N> for values and gradients.
+template <std::size_t N>
+struct Dual
+{
+    double v = 0;
+    std::array<double, N> d{};
+
+    Dual() = default;
+    Dual(double value) : v(value) {}
+    // the i-th input
+    static Dual Variable(double value, std::size_t i)
+    {
+        Dual x(value);
+        x.d[i] = 1;
+        return x;
+    }
+};
+
+inline double Value(double x) { return x; }
+template <std::size_t N>
+double Value(const Dual<N> &x) { return x.v; }
+
+template <std::size_t N>
+Dual<N> operator-(const Dual<N> &a)
+{
+    Dual<N> r(-a.v);
+    for (std::size_t i = 0; i < N; i++)
+        r.d[i] = -a.d[i];
+    return r;
+}
+
+template <std::size_t N>
+Dual<N> operator+(const Dual<N> &a, const Dual<N> &b)
+{
+    Dual<N> r(a.v + b.v);
+    for (std::size_t i = 0; i < N; i++)
+        r.d[i] = a.d[i] + b.d[i];
+    return r;
+}
+
+template <std::size_t N>
+Dual<N> operator-(const Dual<N> &a, const Dual<N> &b)
+{
+    Dual<N> r(a.v - b.v);
+    for (std::size_t i = 0; i < N; i++)
+        r.d[i] = a.d[i] - b.d[i];
+    return r;
+}
+
+template <std::size_t N>
+Dual<N> operator*(const Dual<N> &a, const Dual<N> &b)
+{
+    Dual<N> r(a.v * b.v);
+    for (std::size_t i = 0; i < N; i++)
+        r.d[i] = a.d[i] * b.v + a.v * b.d[i];
+    return r;
+}
+
+template <std::size_t N>
+Dual<N> operator/(const Dual<N> &a, const Dual<N> &b)
+{
+    const double inv = 1 / b.v;
+    Dual<N> r(a.v * inv);
+    for (std::size_t i = 0; i < N; i++)
+        r.d[i] = (a.d[i] - r.v * b.d[i]) * inv;
+    return r;
+}
+
+template <std::size_t N>
+Dual<N> operator+(const Dual<N> &a, double b) { return a + Dual<N>(b); }
+template <std::size_t N>
+Dual<N> operator+(double a, const Dual<N> &b) { return Dual<N>(a) + b; }
+template <std::size_t N>
+Dual<N> operator-(const Dual<N> &a, double b) { return a - Dual<N>(b); }
+template <std::size_t N>
+Dual<N> operator-(double a, const Dual<N> &b) { return Dual<N>(a) - b; }
+template <std::size_t N>
+Dual<N> operator*(const Dual<N> &a, double b)
+{
+    Dual<N> r(a.v * b);
+    for (std::size_t i = 0; i < N; i++)
+        r.d[i] = a.d[i] * b;
+    return r;
+}
+template <std::size_t N>
+Dual<N> operator*(double a, const Dual<N> &b) { return b * a; }
+template <std::size_t N>
+Dual<N> operator/(const Dual<N> &a, double b) { return a * (1 / b); }
+template <std::size_t N>
+Dual<N> operator/(double a, const Dual<N> &b) { return Dual<N>(a) / b; }
+
+template <std::size_t N>
+Dual<N> exp(const Dual<N> &a)
+{
+    Dual<N> r(std::exp(a.v));
+    for (std::size_t i = 0; i < N; i++)
+        r.d[i] = r.v * a.d[i];
+    return r;
+}
+
+#endif // QF633_CODE_DUAL_H
@@ -0,0 +1,179 @@
+#ifndef QF633_CODE_FASTPARSE_H
+#define QF633_CODE_FASTPARSE_H
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+
+#include "Date.h"
+
+// Helpers to tokenize and convert CSV fields in place, without copying them into std::string.
+
+// returns the next line in [cursor, end) without the line terminator ('\n' or "\r\n"), and moves cursor past it
+inline std::string_view NextLine(const char*& cursor, const char* end)
+{
+    const char* begin = cursor;
+    const char* eol = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+    if (eol == nullptr) {
+        eol = end;
+        cursor = end;
+    } else {
+        cursor = eol + 1;
+    }
+    if (eol > begin && eol[-1] == '\r') {
+        --eol;
+    }
+    return std::string_view(begin, eol - begin);
+}
+
+// splits a line on ',' into at most maxFields views, missing trailing fields are left empty; returns number of fields found
+inline std::size_t SplitFields(std::string_view line, std::string_view* fields, std::size_t maxFields)
+{
+    std::size_t n = 0;
+    const char* p = line.data();
+    const char* end = p + line.size();
+    while (n < maxFields) {
+        const char* comma = static_cast<const char*>(std::memchr(p, ',', end - p));
+        if (comma == nullptr) {
+            fields[n++] = std::string_view(p, end - p);
+            break;
+        }
+        fields[n++] = std::string_view(p, comma - p);
+        p = comma + 1;
+    }
+    for (std::size_t i = n; i < maxFields; i++) {
+        fields[i] = std::string_view();
+    }
+    return n;
+}
+
+// Converts a decimal field to double, empty fields become NaN.
+// Plain decimals with at most 15 significant digits go through Clinger's fast path: the mantissa and the
+// power of ten are both exact doubles, so a single multiplication/division is correctly rounded and the
+// result is bit-identical to std::stod. Anything else (exponents, long mantissas, junk) falls back to std::stod.
+inline double ParseDouble(std::string_view s)
+{
+    if (s.empty()) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    const char* p = s.data();
+    const char* end = p + s.size();
+    bool negative = false;
+    if (*p == '-' || *p == '+') {
+        negative = *p == '-';
+        ++p;
+    }
+    uint64_t mantissa = 0;
+    int digits = 0;   // significant digits accumulated in mantissa
+    int fraction = 0; // digits after the decimal point
+    bool seenDigit = false;
+    bool seenDot = false;
+    for (; p < end; ++p) {
+        const unsigned d = static_cast<unsigned>(*p - '0');
+        if (d < 10) {
+            seenDigit = true;
+            mantissa = mantissa * 10 + d;
+            digits += mantissa != 0;
+            fraction += seenDot;
+        } else if (*p == '.' && !seenDot) {
+            seenDot = true;
+        } else {
+            break;
+        }
+    }
+    if (p != end || !seenDigit || digits > 15 || fraction > 22) {
+        return std::stod(std::string(s));
+    }
+    double v = static_cast<double>(mantissa);
+    if (fraction > 0) {
+        v /= pow10[fraction];
+    }
+    return negative ? -v : v;
+}
+
+// Parses the fixed "YYYY-MM-DDTHH:MM:SS[.fff...][Z]" layout into unix epoch milliseconds, sub-millisecond digits
+// are truncated. Returns false when the buffer does not match that layout, the caller is expected to fall back to a
+// general parser. Consecutive rows almost always share a date, so the date part is cached per thread and only the
+// time of day is converted on a cache hit.
+inline bool ParseIsoTimestampMS(const char* s, std::size_t n, uint64_t& ms)
+{
+    struct DateCache {
+        char date[10];
+        uint64_t dayMs;
+        bool valid = false;
+    };
+    thread_local DateCache cache;
+
+    auto digit = [s](std::size_t i) { return static_cast<unsigned>(s[i] - '0'); };
+    auto isDigits = [s](std::size_t from, std::size_t to) {
+        for (std::size_t i = from; i < to; i++) {
+            if (static_cast<unsigned>(s[i] - '0') > 9) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    if (n < 19 || s[10] != 'T' || s[13] != ':' || s[16] != ':') {
+        return false;
+    }
+
+    uint64_t dayMs;
+    if (cache.valid && std::memcmp(cache.date, s, 10) == 0) {
+        dayMs = cache.dayMs;
+    } else {
+        if (s[4] != '-' || s[7] != '-' || !isDigits(0, 4) || !isDigits(5, 7) || !isDigits(8, 10)) {
+            return false;
+        }
+        const int64_t y = digit(0) * 1000 + digit(1) * 100 + digit(2) * 10 + digit(3);
+        const unsigned m = digit(5) * 10 + digit(6);
+        const unsigned d = digit(8) * 10 + digit(9);
+        if (y < 1970 || m < 1 || m > 12 || d < 1 || d > DaysInMonth(y, m)) {
+            return false;
+        }
+        dayMs = static_cast<uint64_t>(DaysFromCivil(y, m, d) * MsPerDay);
+        std::memcpy(cache.date, s, 10);
+        cache.dayMs = dayMs;
+        cache.valid = true;
+    }
+
+    if (!isDigits(11, 13) || !isDigits(14, 16) || !isDigits(17, 19)) {
+        return false;
+    }
+    const unsigned hh = digit(11) * 10 + digit(12);
+    const unsigned mm = digit(14) * 10 + digit(15);
+    const unsigned ss = digit(17) * 10 + digit(18);
+    if (hh > 23 || mm > 59 || ss > 59) {
+        return false;
+    }
+
+    std::size_t i = 19;
+    unsigned millis = 0;
+    if (i < n && s[i] == '.') {
+        ++i;
+        const std::size_t fracBegin = i;
+        unsigned scale = 100;
+        for (; i < n && static_cast<unsigned>(s[i] - '0') <= 9; ++i) {
+            millis += digit(i) * scale;
+            scale /= 10;
+        }
+        if (i == fracBegin) {
+            return false;
+        }
+    }
+    if (i < n && s[i] == 'Z') {
+        ++i;
+    }
+    if (i != n) {
+        return false;
+    }
+
+    ms = dayMs + (hh * 3600 + mm * 60 + ss) * 1000ULL + millis;
+    return true;
+}
+
+#endif // QF633_CODE_FASTPARSE_H
@@ -0,0 +1,203 @@
+#ifndef QF633_CODE_GREEKSENGINE_H
+#define QF633_CODE_GREEKSENGINE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "BSAnalytics.h"
+#include "Date.h"
+#include "Instrument.h"
+#include "ThreadPool.h"
+
+struct Position
+{
+    std::string ContractName; // e.g. BTC-27MAY22-30000-C
+    double Quantity = 1;
+};
+
+// Price and Greeks of a portfolio, see BSGreeks for the conventions
+struct PortfolioGreeks
+{
+    // per unit of each position, in portfolio order; NaN where its underlying's expiry has no fitted smile
+    std::vector<double> Price, Delta, Gamma, Vega, Theta;
+    // sums weighted by quantity over the positions that could be priced
+    BSGreeks Total{};
+    std::size_t NumUnpriced = 0;
+};
+
+// Prices a fixed portfolio of options with the smiles fitted by VolSurfBuilder::FitSmiles, each option at the forward
+// and time to expiry of the smile of its underlying and expiry.
+//
+// SetPortfolio resolves the contracts once and lays the positions out by expiry, so Compute evaluates each expiry's
+// smile and Black-Scholes kernels over contiguous strikes, sharing the forward and time to expiry, and splits the work
+// into blocks across the thread pool.
+template <class Smile>
+class GreeksEngine
+{
+public:
+    // throws std::invalid_argument if a contract is not an option
+    void SetPortfolio(const std::vector<Position> &positions);
+    void Compute(const std::map<ExpiryKey, std::pair<Smile, double>> &fits, PortfolioGreeks &out);
+    // number of threads Compute runs on (1: serial, the default; 0: hardware concurrency). The result does not
+    // depend on it.
+    void SetThreads(unsigned numThreads);
+
+private:
+    static constexpr std::size_t BlockSize = 1024;
+
+    // the positions of one expiry of one underlying occupy [begin, end) of the by-expiry arrays
+    struct ExpiryGroup
+    {
+        ExpiryKey Key;
+        std::size_t begin, end;
+    };
+    // a slice of one group, the unit of parallel work
+    struct Block
+    {
+        std::size_t group, begin, end;
+    };
+    std::vector<ExpiryGroup> groups;
+    std::vector<Block> blocks;
+    // positions ordered by expiry
+    std::vector<OptionType> optType;
+    std::vector<double> strike;
+    std::vector<double> quantity;
+    std::vector<uint32_t> positionIndex; // index in the portfolio
+    // per expiry, for the current Compute: the smile or null, its forward and time to expiry
+    std::vector<const Smile *> groupSmile;
+    std::vector<double> groupFwd, groupT;
+    // per block, filled by Compute
+    std::vector<double> vol, price, delta, gamma, vega, theta;
+    std::vector<BSGreeks> blockTotal;
+    std::unique_ptr<ThreadPool> pool;
+};
+
+template <class Smile>
+void GreeksEngine<Smile>::SetThreads(unsigned numThreads)
+{
+    pool.reset();
+    if (numThreads != 1)
+        pool = std::make_unique<ThreadPool>(numThreads);
+}
+
+template <class Smile>
+void GreeksEngine<Smile>::SetPortfolio(const std::vector<Position> &positions)
+{
+    InstrumentRegistry &registry = InstrumentRegistry::Instance();
+    std::vector<std::pair<uint32_t, uint32_t>> byExpiry; // (ExpiryId, position), the ExpiryId telling underlyings apart
+    std::vector<const Instrument *> instruments;
+    for (std::size_t i = 0; i < positions.size(); i++)
+    {
+        const Instrument &instrument = registry.Get(registry.Intern(positions[i].ContractName));
+        if (!instrument.IsOption)
+            throw std::invalid_argument(positions[i].ContractName + " is not an option");
+        instruments.push_back(&instrument);
+        byExpiry.emplace_back(instrument.ExpiryId, static_cast<uint32_t>(i));
+    }
+    std::sort(byExpiry.begin(), byExpiry.end());
+
+    const std::size_t n = positions.size();
+    groups.clear();
+    blocks.clear();
+    optType.resize(n);
+    strike.resize(n);
+    quantity.resize(n);
+    positionIndex.resize(n);
+    for (std::size_t j = 0; j < n; j++)
+    {
+        const uint32_t i = byExpiry[j].second;
+        optType[j] = instruments[i]->IsCall ? Call : Put;
+        strike[j] = instruments[i]->Strike;
+        quantity[j] = positions[i].Quantity;
+        positionIndex[j] = i;
+        if (groups.empty() || byExpiry[j].first != byExpiry[j - 1].first)
+            groups.push_back({ExpiryKey{instruments[i]->Underlying, instruments[i]->ExpiryDate}, j, j});
+        groups.back().end = j + 1;
+    }
+    for (std::size_t g = 0; g < groups.size(); g++)
+        for (std::size_t begin = groups[g].begin; begin < groups[g].end; begin += BlockSize)
+            blocks.push_back({g, begin, std::min(begin + BlockSize, groups[g].end)});
+    groupSmile.resize(groups.size());
+    groupFwd.resize(groups.size());
+    groupT.resize(groups.size());
+    for (auto *v : {&vol, &price, &delta, &gamma, &vega, &theta})
+        v->resize(n);
+    blockTotal.resize(blocks.size());
+}
+
+template <class Smile>
+void GreeksEngine<Smile>::Compute(const std::map<ExpiryKey, std::pair<Smile, double>> &fits, PortfolioGreeks &out)
+{
+    for (std::size_t g = 0; g < groups.size(); g++)
+    {
+        const auto fit = fits.find(groups[g].Key);
+        groupSmile[g] = fit == fits.end() ? nullptr : &fit->second.first;
+        groupFwd[g] = groupSmile[g] ? groupSmile[g]->Forward() : 0;
+        groupT[g] = groupSmile[g] ? groupSmile[g]->TimeToExpiry() : 0;
+    }
+
+    auto computeBlock = [&](std::size_t b) {
+        const Block &block = blocks[b];
+        const Smile *smile = groupSmile[block.group];
+        const std::size_t begin = block.begin, m = block.end - block.begin;
+        BSGreeks &total = blockTotal[b];
+        total = BSGreeks{};
+        if (!smile)
+        {
+            for (auto *v : {&price, &delta, &gamma, &vega, &theta})
+                std::fill(v->begin() + begin, v->begin() + block.end, std::numeric_limits<double>::quiet_NaN());
+            return;
+        }
+        smile->Vol(&strike[begin], &vol[begin], m);
+        bsGreeksBatch(&optType[begin], &strike[begin], groupFwd[block.group], groupT[block.group], &vol[begin],
+                      &price[begin], &delta[begin], &gamma[begin], &vega[begin], &theta[begin], m);
+        for (std::size_t j = begin; j < block.end; j++)
+        {
+            total.price += quantity[j] * price[j];
+            total.delta += quantity[j] * delta[j];
+            total.gamma += quantity[j] * gamma[j];
+            total.vega += quantity[j] * vega[j];
+            total.theta += quantity[j] * theta[j];
+        }
+    };
+    if (pool)
+        pool->ParallelFor(blocks.size(), computeBlock);
+    else
+        for (std::size_t b = 0; b < blocks.size(); b++)
+            computeBlock(b);
+
+    // back to portfolio order; totals summed block by block in a fixed order so they do not depend on the threads
+    const std::size_t n = positionIndex.size();
+    for (auto *v : {&out.Price, &out.Delta, &out.Gamma, &out.Vega, &out.Theta})
+        v->resize(n);
+    for (std::size_t j = 0; j < n; j++)
+    {
+        const uint32_t i = positionIndex[j];
+        out.Price[i] = price[j];
+        out.Delta[i] = delta[j];
+        out.Gamma[i] = gamma[j];
+        out.Vega[i] = vega[j];
+        out.Theta[i] = theta[j];
+    }
+    out.Total = BSGreeks{};
+    out.NumUnpriced = 0;
+    for (std::size_t b = 0; b < blocks.size(); b++)
+    {
+        out.Total.price += blockTotal[b].price;
+        out.Total.delta += blockTotal[b].delta;
+        out.Total.gamma += blockTotal[b].gamma;
+        out.Total.vega += blockTotal[b].vega;
+        out.Total.theta += blockTotal[b].theta;
+        if (!groupSmile[blocks[b].group])
+            out.NumUnpriced += blocks[b].end - blocks[b].begin;
+    }
+}
+
+#endif // QF633_CODE_GREEKSENGINE_H
@@ -0,0 +1,140 @@
+#include "Instrument.h"
+
+#include <cstdlib>
+#include <stdexcept>
+
+namespace {
+
+int MonthFromName(std::string_view mmm)
+{
+    static const char *names[] = {"JAN", "FEB", "MAR", "APR", "MAY", "JUN",
+                                  "JUL", "AUG", "SEP", "OCT", "NOV", "DEC"};
+    for (int m = 0; m < 12; m++) {
+        if (mmm == names[m]) {
+            return m + 1;
+        }
+    }
+    return 0;
+}
+
+bool ParseInt(std::string_view s, int &out)
+{
+    if (s.empty()) {
+        return false;
+    }
+    out = 0;
+    for (char c : s) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        out = out * 10 + (c - '0');
+    }
+    return true;
+}
+
+} // namespace
+
+bool ParseContractName(std::string_view contractName, Instrument &instrument)
+{
+    // split UNDERLYING-DMMMYY-STRIKE-C/P on '-'
+    std::string_view parts[4];
+    std::size_t begin = 0;
+    for (int i = 0; i < 4; i++) {
+        std::size_t dash = contractName.find('-', begin);
+        if ((dash == std::string_view::npos) != (i == 3)) {
+            return false;
+        }
+        parts[i] = contractName.substr(begin, dash == std::string_view::npos ? std::string_view::npos : dash - begin);
+        begin = dash + 1;
+    }
+
+    // expiry is DMMMYY or DDMMMYY
+    const std::string_view expiry = parts[1];
+    if (expiry.length() != 6 && expiry.length() != 7) {
+        return false;
+    }
+    const std::size_t dayLen = expiry.length() - 5;
+    int d, m, y;
+    if (!ParseInt(expiry.substr(0, dayLen), d) || !ParseInt(expiry.substr(dayLen + 3, 2), y) ||
+        (m = MonthFromName(expiry.substr(dayLen, 3))) == 0) {
+        return false;
+    }
+    if (parts[3] != "C" && parts[3] != "P") {
+        return false;
+    }
+    char *end = nullptr;
+    const std::string strike(parts[2]);
+    const double k = std::strtod(strike.c_str(), &end);
+    if (strike.empty() || *end != '\0') {
+        return false;
+    }
+
+    instrument.Underlying = std::string(parts[0]);
+    instrument.ExpiryDate = datetime_t(2000 + y, m, d);
+    instrument.Strike = k;
+    instrument.IsCall = parts[3] == "C";
+
+    // midnight UTC of the expiry date
+    instrument.ExpiryTimeMS = static_cast<uint64_t>(instrument.ExpiryDate.UnixMS());
+    instrument.IsOption = true;
+    return true;
+}
+
+InstrumentRegistry &InstrumentRegistry::Instance()
+{
+    static InstrumentRegistry registry;
+    return registry;
+}
+
+instrument_id_t InstrumentRegistry::Intern(std::string_view contractName)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = ids_.find(contractName);
+    if (it != ids_.end()) {
+        return it->second;
+    }
+
+    const std::size_t id = size_.load(std::memory_order_relaxed);
+    if (id >= ChunkSize * MaxChunks) {
+        throw std::length_error("too many instruments");
+    }
+    auto &chunk = chunks_[id >> ChunkBits];
+    if (!chunk) {
+        chunk = std::make_unique<Instrument[]>(ChunkSize);
+    }
+    Instrument &instrument = chunk[id & (ChunkSize - 1)];
+    instrument.Name = std::string(contractName);
+    instrument.Underlying = instrument.Name.substr(0, instrument.Name.find('-'));
+    if (ParseContractName(instrument.Name, instrument)) {
+        auto expiry = expiryIds_.emplace(std::make_pair(std::string_view(instrument.Underlying), instrument.ExpiryTimeMS),
+                                         static_cast<uint32_t>(expiryIds_.size()));
+        instrument.ExpiryId = expiry.first->second;
+        numExpiries_.store(expiryIds_.size(), std::memory_order_release);
+    }
+
+    ids_.emplace(instrument.Name, static_cast<instrument_id_t>(id));
+    size_.store(id + 1, std::memory_order_release);
+    return static_cast<instrument_id_t>(id);
+}
+
+uint32_t InstrumentRegistry::InternIndex(std::string_view indexName)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = indexIds_.find(indexName);
+    if (it != indexIds_.end()) {
+        return it->second;
+    }
+
+    const std::size_t id = indexIds_.size();
+    if (id >= ChunkSize * MaxIndexChunks) {
+        throw std::length_error("too many underlying index names");
+    }
+    auto &chunk = indexChunks_[id >> ChunkBits];
+    if (!chunk) {
+        chunk = std::make_unique<std::string[]>(ChunkSize);
+    }
+    std::string &name = chunk[id & (ChunkSize - 1)];
+    name = std::string(indexName);
+    indexIds_.emplace(name, static_cast<uint32_t>(id));
+    return static_cast<uint32_t>(id);
+}
@@ -0,0 +1,94 @@
+#ifndef QF633_CODE_INSTRUMENT_H
+#define QF633_CODE_INSTRUMENT_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include "Date.h"
+
+using instrument_id_t = uint32_t;
+
+// static description of a contract, parsed once from its name, e.g. BTC-27MAY22-30000-C
+struct Instrument {
+    std::string Name;
+    std::string Underlying; // BTC, the name up to the first '-' for any contract, option or not
+    bool IsOption = false;  // false if the name does not follow UNDERLYING-DMMMYY-STRIKE-C/P
+    bool IsCall = false;
+    double Strike = 0;
+    datetime_t ExpiryDate;  // 2022-05-27
+    uint64_t ExpiryTimeMS = 0; // expiry date as unix epoch milliseconds
+    uint32_t ExpiryId = NoExpiry; // dense id shared by all options on Underlying expiring on ExpiryDate
+    static constexpr uint32_t NoExpiry = UINT32_MAX;
+};
+
+// an expiry of one underlying, e.g. (BTC, 2022-05-27): what VolSurfBuilder fits a smile for
+struct ExpiryKey {
+    std::string Underlying;
+    datetime_t Expiry;
+};
+inline bool operator<(const ExpiryKey& a, const ExpiryKey& b)
+{
+    return a.Underlying < b.Underlying || (a.Underlying == b.Underlying && a.Expiry < b.Expiry);
+}
+inline bool operator==(const ExpiryKey& a, const ExpiryKey& b)
+{
+    return a.Underlying == b.Underlying && a.Expiry == b.Expiry;
+}
+
+// Process wide table interning contract names into dense ids, so the hot path never parses names again. Underlying
+// index names (SYN.BTC-27MAY22) are interned alongside, so ticks carry no strings.
+// Intern() and InternIndex() are thread safe, and do not allocate for a name seen before. Get() and IndexName() are
+// lock free: entries are never moved once created, and an id can only be observed after the entry behind it is fully
+// constructed.
+class InstrumentRegistry
+{
+public:
+    static InstrumentRegistry& Instance();
+
+    instrument_id_t Intern(std::string_view contractName);
+    const Instrument& Get(instrument_id_t id) const
+    {
+        return chunks_[id >> ChunkBits][id & (ChunkSize - 1)];
+    }
+    std::size_t Size() const { return size_.load(std::memory_order_acquire); }
+    std::size_t NumExpiries() const { return numExpiries_.load(std::memory_order_acquire); }
+
+    uint32_t InternIndex(std::string_view indexName);
+    const std::string& IndexName(uint32_t id) const
+    {
+        return indexChunks_[id >> ChunkBits][id & (ChunkSize - 1)];
+    }
+
+private:
+    InstrumentRegistry() = default;
+
+    static constexpr unsigned ChunkBits = 12;
+    static constexpr std::size_t ChunkSize = std::size_t(1) << ChunkBits;
+    static constexpr std::size_t MaxChunks = 1024;
+
+    std::mutex mutex_;
+    std::unique_ptr<Instrument[]> chunks_[MaxChunks];
+    std::atomic<std::size_t> size_{0};
+    // keys point into Instrument::Name, which stays in place for the lifetime of the registry
+    std::unordered_map<std::string_view, instrument_id_t> ids_;
+    // (Underlying, expiry date as epoch milliseconds) to ExpiryId, the underlying pointing into Instrument::Underlying:
+    // BTC and ETH options expiring on the same day are separate expiries with their own forward and smile
+    std::map<std::pair<std::string_view, uint64_t>, uint32_t> expiryIds_;
+    std::atomic<std::size_t> numExpiries_{0};
+
+    static constexpr std::size_t MaxIndexChunks = 16;
+    std::unique_ptr<std::string[]> indexChunks_[MaxIndexChunks];
+    std::unordered_map<std::string_view, uint32_t> indexIds_; // keys point into indexChunks_
+};
+
+// parses UNDERLYING-DMMMYY-STRIKE-C/P, returns false (leaving IsOption unset) for any other name
+bool ParseContractName(std::string_view contractName, Instrument& instrument);
+
+#endif // QF633_CODE_INSTRUMENT_H
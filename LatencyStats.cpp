@@ -0,0 +1,101 @@
+#include "LatencyStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ostream>
+
+uint64_t LatencyHistogram::BucketUpper(std::size_t bucket) {
+    if (bucket < SubBuckets) {
+        return bucket;
+    }
+    const unsigned shift = static_cast<unsigned>(bucket / SubBuckets - 1);
+    const uint64_t lower = static_cast<uint64_t>(SubBuckets + bucket % SubBuckets) << shift;
+    return lower + ((uint64_t(1) << shift) - 1);
+}
+
+uint64_t LatencyHistogram::Percentile(double q) const {
+    const uint64_t count = Count();
+    if (count == 0) {
+        return 0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * count)));
+    uint64_t seen = 0;
+    for (std::size_t b = 0; b < NumBuckets; b++) {
+        seen += counts_[b].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            return std::min(BucketUpper(b), Max());
+        }
+    }
+    return Max(); // records that landed while we scanned
+}
+
+void LatencyHistogram::Reset() {
+    for (auto &c : counts_) {
+        c.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+LatencyStats &LatencyStats::Instance() {
+    static LatencyStats stats;
+    return stats;
+}
+
+LatencyStats::LatencyStats()
+        : stages_(new LatencyHistogram[static_cast<std::size_t>(LatencyStage::Count)]),
+          expiries_(new LatencyHistogram[MaxExpiries + 1]),
+          expiryMS_(new std::atomic<int64_t>[MaxExpiries + 1]()) {
+}
+
+void LatencyStats::Dump(std::ostream &os, uint64_t now_ms) const {
+    static const char *const stageNames[] = {"ReadNextMsg", "Process", "FitSmiles", "FitSmile", "Output"};
+    char line[160];
+    auto row = [&os, &line](const char *name, const LatencyHistogram &h) {
+        std::snprintf(line, sizeof(line), "%-16s %10llu %10.0f %10llu %10llu %10llu %10llu\n", name,
+                      static_cast<unsigned long long>(h.Count()), h.Mean(),
+                      static_cast<unsigned long long>(h.Percentile(0.5)),
+                      static_cast<unsigned long long>(h.Percentile(0.99)),
+                      static_cast<unsigned long long>(h.Percentile(0.999)), static_cast<unsigned long long>(h.Max()));
+        os << line;
+    };
+
+    os << "latency (ns)";
+    if (now_ms != 0) {
+        const datetime_t now = datetime_t::FromUnixMS(static_cast<int64_t>(now_ms));
+        std::snprintf(line, sizeof(line), " as of %04d-%02d-%02dT%02d:%02d:%02d", now.Year(), now.Month(), now.Day(),
+                      now.Hour(), now.Min(), now.Sec());
+        os << line;
+    }
+    std::snprintf(line, sizeof(line), "\n%-16s %10s %10s %10s %10s %10s %10s\n", "stage", "count", "mean", "p50", "p99",
+                  "p999", "max");
+    os << line;
+    for (std::size_t s = 0; s < static_cast<std::size_t>(LatencyStage::Count); s++) {
+        row(stageNames[s], stages_[s]);
+    }
+    for (std::size_t e = 0; e <= MaxExpiries; e++) {
+        if (expiries_[e].Count() == 0) {
+            continue;
+        }
+        char name[32];
+        if (e < MaxExpiries) {
+            const datetime_t expiry = datetime_t::FromUnixMS(expiryMS_[e].load(std::memory_order_relaxed));
+            std::snprintf(name, sizeof(name), "  %04d-%02d-%02d", expiry.Year(), expiry.Month(), expiry.Day());
+        } else {
+            std::snprintf(name, sizeof(name), "  later expiries");
+        }
+        row(name, expiries_[e]);
+    }
+    os.flush();
+}
+
+void LatencyStats::Reset() {
+    for (std::size_t s = 0; s < static_cast<std::size_t>(LatencyStage::Count); s++) {
+        stages_[s].Reset();
+    }
+    for (std::size_t e = 0; e <= MaxExpiries; e++) {
+        expiries_[e].Reset();
+    }
+}
@@ -0,0 +1,130 @@
+#ifndef QF633_CODE_LATENCYSTATS_H
+#define QF633_CODE_LATENCYSTATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+
+#include "Date.h"
+
+// Latency histogram with HDR-style log-linear buckets: values below 16 ns are exact, above that every power of two is
+// split into 16 buckets, so a percentile is within 1/16 of the true value. Record is lock free (relaxed atomics) and
+// may run on any number of threads; the readers see a consistent enough picture for monitoring.
+class LatencyHistogram
+{
+public:
+    static constexpr unsigned SubBucketBits = 4;
+    static constexpr std::size_t SubBuckets = std::size_t(1) << SubBucketBits;
+    static constexpr std::size_t NumBuckets = SubBuckets * (64 - SubBucketBits + 1);
+
+    void Record(uint64_t ns)
+    {
+        counts_[BucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (ns > max && !max_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t Max() const { return max_.load(std::memory_order_relaxed); }
+    double Mean() const { return Count() ? static_cast<double>(sum_.load(std::memory_order_relaxed)) / Count() : 0; }
+    // the upper end of the bucket holding the q quantile, capped at Max(); 0 if nothing was recorded
+    uint64_t Percentile(double q) const;
+    void Reset();
+
+private:
+    static std::size_t BucketOf(uint64_t v)
+    {
+        if (v < SubBuckets)
+            return static_cast<std::size_t>(v);
+        unsigned shift = 0; // v >> shift lands in [SubBuckets, 2 SubBuckets)
+        while ((v >> shift) >= 2 * SubBuckets)
+            shift++;
+        return SubBuckets * (shift + 1) + static_cast<std::size_t>((v >> shift) - SubBuckets);
+    }
+    static uint64_t BucketUpper(std::size_t bucket);
+
+    std::atomic<uint64_t> counts_[NumBuckets] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+// the stages of the replay loop that are timed
+enum class LatencyStage
+{
+    ReadMsg,   // ReadNextMsg, on the reader thread when the csv is parsed ahead
+    Process,   // VolSurfBuilder::Process
+    FitSmiles, // VolSurfBuilder::FitSmiles, all expiries
+    FitSmile,  // one expiry's Smile::FitSmile and fitting error, also kept per expiry
+    Output,    // formatting and writing the fitted smiles of one timer tick
+    Count
+};
+
+// Process wide latency histograms per stage and per expiry, fed by the QF633_PROFILE_* probes below.
+class LatencyStats
+{
+public:
+    // expiries with an ExpiryId past this share one histogram
+    static constexpr std::size_t MaxExpiries = 128;
+
+    static LatencyStats &Instance();
+
+    LatencyHistogram &Stage(LatencyStage stage) { return stages_[static_cast<std::size_t>(stage)]; }
+    LatencyHistogram &Expiry(uint32_t expiryId, datetime_t expiry)
+    {
+        const std::size_t i = expiryId < MaxExpiries ? expiryId : MaxExpiries;
+        expiryMS_[i].store(expiry.UnixMS(), std::memory_order_relaxed);
+        return expiries_[i];
+    }
+
+    // count, mean, p50, p99, p999 and max in ns of every stage and expiry recorded so far, headed by now_ms if given
+    void Dump(std::ostream &os, uint64_t now_ms = 0) const;
+    void Reset();
+
+private:
+    LatencyStats();
+
+    std::unique_ptr<LatencyHistogram[]> stages_;
+    std::unique_ptr<LatencyHistogram[]> expiries_;
+    std::unique_ptr<std::atomic<int64_t>[]> expiryMS_;
+};
+
+// times its own lifetime into a histogram
+class ScopedLatency
+{
+public:
+    explicit ScopedLatency(LatencyHistogram &histogram)
+        : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedLatency()
+    {
+        const auto elapsed = std::chrono::steady_clock::now() - start_;
+        histogram_.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+    ScopedLatency(const ScopedLatency &) = delete;
+    ScopedLatency &operator=(const ScopedLatency &) = delete;
+
+private:
+    LatencyHistogram &histogram_;
+    const std::chrono::steady_clock::time_point start_;
+};
+
+// Probes timing the rest of the enclosing scope. They compile to nothing unless QF633_ENABLE_PROFILING is defined.
+#ifdef QF633_ENABLE_PROFILING
+#define QF633_PROFILE_CONCAT_(a, b) a##b
+#define QF633_PROFILE_CONCAT(a, b) QF633_PROFILE_CONCAT_(a, b)
+#define QF633_PROFILE_STAGE(stage) \
+    ScopedLatency QF633_PROFILE_CONCAT(profileStage_, __LINE__)(LatencyStats::Instance().Stage(stage))
+#define QF633_PROFILE_EXPIRY(expiryId, expiry) \
+    ScopedLatency QF633_PROFILE_CONCAT(profileExpiry_, __LINE__)(LatencyStats::Instance().Expiry(expiryId, expiry))
+#else
+#define QF633_PROFILE_STAGE(stage) ((void)0)
+#define QF633_PROFILE_EXPIRY(expiryId, expiry) ((void)0)
+#endif
+
+#endif // QF633_CODE_LATENCYSTATS_H
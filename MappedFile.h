@@ -0,0 +1,25 @@
+#ifndef QF633_CODE_MAPPEDFILE_H
+#define QF633_CODE_MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+// read-only memory mapping of a whole file, released in the destructor
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* Data() const { return data_; }
+    std::size_t Size() const { return size_; }
+    const char* End() const { return data_ + size_; }
+
+private:
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+#endif // QF633_CODE_MAPPEDFILE_H
@@ -3,13 +3,17 @@
 
 #include <cstdint>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <ctime>
 #include <sstream>
 #include <iomanip>
 
+#include "Instrument.h"
+
+// one row of the ticker csv. Names are interned, so ticks are plain data: copying one never allocates.
 struct TickData {
-    std::string ContractName;
+    instrument_id_t InstrumentId; // the contract, its name is InstrumentRegistry::Get(InstrumentId).Name
     double BestBidPrice;
     double BestBidAmount;
     double BestBidIV;
@@ -18,13 +22,17 @@ struct TickData {
     double BestAskIV;
     double MarkPrice;
     double MarkIV;
-    std::string UnderlyingIndex;
+    uint32_t UnderlyingIndexId;   // InstrumentRegistry::IndexName(UnderlyingIndexId) is the underlyingIndex column
     double UnderlyingPrice;
     double LastPrice;
     double OpenInterest;
     uint64_t LastUpdateTimeStamp;
 };
 
+static_assert(std::is_trivially_copyable<TickData>::value, "ticks are copied and reused as plain data");
+
+// Updates keeps its capacity when a feeder reads the next message into the same Msg, so at steady state reading
+// allocates nothing.
 struct Msg {
     uint64_t timestamp{};
     bool isSnap;
@@ -0,0 +1,55 @@
+#include "PartitionedReplay.h"
+
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+PartitionedReplay::PartitionedReplay(std::string ticker_filename, std::chrono::minutes interval)
+        : ticker_filename_(std::move(ticker_filename)),
+          interval_(interval) {
+    const std::vector<CsvMsgIndex> index = IndexCsvMessages(ticker_filename_);
+    if (index.empty()) {
+        throw std::invalid_argument("empty message at initialization");
+    }
+
+    // the first chunk starts at the top, so its feeder skips the header and any updates before the first snapshot
+    // like the serial one does
+    uint64_t now_ms = index.front().timestamp;
+    chunks_.push_back({0, 0, now_ms});
+    const uint64_t interval_ms = std::chrono::milliseconds(interval_).count();
+    for (std::size_t i = 0; i < index.size(); i++) {
+        if (i > 0 && index[i].isSnap) {
+            chunks_.back().end = index[i].offset;
+            chunks_.push_back({index[i].offset, 0, now_ms});
+        }
+        // same timer semantics as CsvFeeder::Step
+        if (now_ms < index[i].timestamp) {
+            now_ms += interval_ms;
+        }
+    }
+    chunks_.back().end = MappedFile(ticker_filename_).Size();
+}
+
+void PartitionedReplay::Run(unsigned numThreads, ChunkFactory make_listeners, ChunkDone chunk_done) {
+    std::mutex done_mutex;
+    std::vector<char> done(chunks_.size(), 0);
+    std::size_t next_done = 0;
+
+    ThreadPool pool(numThreads);
+    pool.ParallelFor(chunks_.size(), [&](std::size_t chunk) {
+        const Listeners listeners = make_listeners(chunk);
+        CsvFeeder feeder(ticker_filename_, listeners.feed, interval_, listeners.timer, chunks_[chunk]);
+        while (feeder.Step()) {
+        }
+
+        // chunks are handed out in order, so completed chunks are rarely held back for long
+        std::lock_guard<std::mutex> lock(done_mutex);
+        done[chunk] = 1;
+        while (next_done < chunks_.size() && done[next_done]) {
+            chunk_done(next_done++);
+        }
+    });
+}
@@ -0,0 +1,46 @@
+#ifndef QF633_CODE_PARTITIONEDREPLAY_H
+#define QF633_CODE_PARTITIONEDREPLAY_H
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "CsvFeeder.h"
+
+// Replays a ticker csv in parallel, split at its snapshots.
+//
+// A snapshot replaces the whole book and VolSurfBuilder drops its last fits with it, so the messages from one snapshot
+// up to the next replay the same whatever came before. The constructor indexes the message boundaries and runs the
+// interval timer of CsvFeeder::Step over the message timestamps to know its value at every snapshot; Run then replays
+// the chunks on a thread pool, each through its own CsvFeeder and listeners. Every chunk delivers the same messages
+// and timer calls as the serial replay of the whole file does over that stretch.
+class PartitionedReplay
+{
+public:
+    using FeedListener = CsvFeeder::FeedListener;
+    using TimerListener = CsvFeeder::TimerListener;
+    struct Listeners
+    {
+        FeedListener feed;
+        TimerListener timer;
+    };
+    // called on the thread replaying the chunk, before its first message
+    using ChunkFactory = std::function<Listeners(std::size_t chunk)>;
+    // called in chunk order once the chunk and all chunks before it are replayed, never concurrently
+    using ChunkDone = std::function<void(std::size_t chunk)>;
+
+    PartitionedReplay(std::string ticker_filename, std::chrono::minutes interval);
+    std::size_t NumChunks() const { return chunks_.size(); }
+
+    // replays every chunk on numThreads threads (0: hardware concurrency), rethrowing the first error
+    void Run(unsigned numThreads, ChunkFactory make_listeners, ChunkDone chunk_done);
+
+private:
+    const std::string ticker_filename_;
+    const std::chrono::minutes interval_;
+    std::vector<CsvFeedRange> chunks_;
+};
+
+#endif // QF633_CODE_PARTITIONEDREPLAY_H
@@ -0,0 +1,76 @@
+#ifndef QF633_CODE_QUOTESTORE_H
+#define QF633_CODE_QUOTESTORE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Date.h"
+#include "Instrument.h"
+#include "Msg.h"
+
+// Live quotes of one expiry in struct-of-arrays layout, one row per instrument of the current snapshot, in order
+// of arrival since the last snap. VolSurfBuilder keeps one per expiry and updates rows in place, so smile fitting
+// and error evaluation read contiguous columns instead of copying TickData around.
+struct ExpiryQuotes {
+    std::string Underlying;
+    datetime_t Expiry;
+    uint64_t ExpiryTimeMS = 0;
+
+    std::vector<instrument_id_t> InstrumentId;
+    std::vector<double> Strike;
+    std::vector<double> BestBidPrice;
+    std::vector<double> BestAskPrice;
+    std::vector<double> BestBidIV;
+    std::vector<double> BestAskIV;
+    std::vector<double> MarkIV;
+    std::vector<double> UnderlyingPrice;
+    std::vector<uint64_t> LastUpdateTimeStamp;
+
+    std::size_t Size() const { return InstrumentId.size(); }
+
+    // drops all rows but keeps the column storage
+    void Clear()
+    {
+        InstrumentId.clear();
+        Strike.clear();
+        BestBidPrice.clear();
+        BestAskPrice.clear();
+        BestBidIV.clear();
+        BestAskIV.clear();
+        MarkIV.clear();
+        UnderlyingPrice.clear();
+        LastUpdateTimeStamp.clear();
+    }
+
+    // appends a row for the instrument and returns its index, the quote columns are filled by Set()
+    std::size_t Add(instrument_id_t id, const Instrument& instrument)
+    {
+        Underlying = instrument.Underlying;
+        Expiry = instrument.ExpiryDate;
+        ExpiryTimeMS = instrument.ExpiryTimeMS;
+        InstrumentId.push_back(id);
+        Strike.push_back(instrument.Strike);
+        BestBidPrice.emplace_back();
+        BestAskPrice.emplace_back();
+        BestBidIV.emplace_back();
+        BestAskIV.emplace_back();
+        MarkIV.emplace_back();
+        UnderlyingPrice.emplace_back();
+        LastUpdateTimeStamp.emplace_back();
+        return InstrumentId.size() - 1;
+    }
+
+    void Set(std::size_t row, const TickData& ticker)
+    {
+        BestBidPrice[row] = ticker.BestBidPrice;
+        BestAskPrice[row] = ticker.BestAskPrice;
+        BestBidIV[row] = ticker.BestBidIV;
+        BestAskIV[row] = ticker.BestAskIV;
+        MarkIV[row] = ticker.MarkIV;
+        UnderlyingPrice[row] = ticker.UnderlyingPrice;
+        LastUpdateTimeStamp[row] = ticker.LastUpdateTimeStamp;
+    }
+};
+
+#endif // QF633_CODE_QUOTESTORE_H
@@ -0,0 +1,217 @@
+#include "ShardedReplay.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "BinaryFeeder.h"
+#include "BinaryTickLog.h"
+#include "CsvFeeder.h"
+
+namespace {
+
+// unwinds a thread whose peer has stopped, the error that caused it is already recorded
+struct ReplayStopped {};
+
+} // namespace
+
+ShardedReplay::ShardedReplay(std::vector<std::string> ticker_filenames, ShardFactory shard_factory,
+                             std::chrono::minutes interval)
+        : shard_factory_(std::move(shard_factory)),
+          interval_(interval) {
+    for (auto &filename : ticker_filenames) {
+        sources_.push_back(std::make_unique<Source>());
+        sources_.back()->filename = std::move(filename);
+    }
+}
+
+ShardedReplay::~ShardedReplay() {
+    StopAll();
+    JoinAll();
+}
+
+void ShardedReplay::Run() {
+    for (auto &source : sources_) {
+        source->thread = std::thread(&ShardedReplay::ReadSource, this, std::ref(*source));
+    }
+
+    try {
+        std::vector<Msg *> heads;
+        for (auto &source : sources_) {
+            heads.push_back(source->ring.BeginRead());
+        }
+        bool started = false;
+        uint64_t now_ms = 0;
+        while (!failed_.load(std::memory_order_relaxed)) {
+            // the earliest head, the first file wins ties
+            std::size_t next = heads.size();
+            for (std::size_t i = 0; i < heads.size(); i++) {
+                if (heads[i] && (next == heads.size() || heads[i]->timestamp < heads[next]->timestamp)) {
+                    next = i;
+                }
+            }
+            if (next == heads.size()) {
+                break;
+            }
+            const Msg &msg = *heads[next];
+            if (!started) {
+                now_ms = msg.timestamp;
+                started = true;
+            }
+            Dispatch(msg);
+            // same timer semantics as CsvFeeder::Step
+            if (now_ms < msg.timestamp) {
+                BroadcastTimer(now_ms);
+                now_ms += interval_.count();
+            }
+            sources_[next]->ring.EndRead();
+            heads[next] = sources_[next]->ring.BeginRead();
+        }
+    } catch (const ReplayStopped &) {
+    } catch (...) {
+        Fail(std::current_exception());
+    }
+
+    if (failed_.load()) {
+        StopAll();
+    }
+    JoinAll();
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+}
+
+void ShardedReplay::ReadSource(Source &source) {
+    try {
+        auto copy = [&source](const Msg &msg) {
+            Msg *slot = source.ring.BeginWrite();
+            if (slot == nullptr) {
+                throw ReplayStopped{};
+            }
+            *slot = msg;
+            source.ring.CommitWrite();
+        };
+        auto ignore_timer = [](uint64_t) {};
+        if (IsBinaryTickLog(source.filename)) {
+            BinaryFeeder feeder(source.filename, copy, std::chrono::duration_cast<std::chrono::minutes>(interval_),
+                                ignore_timer);
+            while (feeder.Step()) {
+            }
+        } else {
+            // this thread already parses ahead of the replay thread, no need for CsvFeeder's own reader
+            CsvFeeder feeder(source.filename, copy, std::chrono::duration_cast<std::chrono::minutes>(interval_),
+                             ignore_timer, CsvReadMode::MemoryMapped, false);
+            while (feeder.Step()) {
+            }
+        }
+    } catch (const ReplayStopped &) {
+    } catch (...) {
+        Fail(std::current_exception());
+    }
+    source.ring.Close();
+}
+
+void ShardedReplay::RunShard(Shard &shard) {
+    try {
+        while (Event *event = shard.ring.BeginRead()) {
+            if (failed_.load(std::memory_order_relaxed)) {
+                break;
+            }
+            if (event->isTimer) {
+                shard.listeners.timer(event->now_ms);
+            } else {
+                shard.listeners.feed(event->msg);
+            }
+            shard.ring.EndRead();
+        }
+    } catch (...) {
+        Fail(std::current_exception());
+    }
+    shard.ring.Stop();
+}
+
+ShardedReplay::Shard &ShardedReplay::ShardOf(instrument_id_t id) {
+    if (id >= shard_by_id_.size()) {
+        shard_by_id_.resize(std::max<std::size_t>(id + 1, InstrumentRegistry::Instance().Size()), nullptr);
+    }
+    Shard *&shard = shard_by_id_[id];
+    if (shard == nullptr) {
+        const std::string &underlying = InstrumentRegistry::Instance().Get(id).Underlying;
+        auto it = shard_by_underlying_.find(underlying);
+        if (it == shard_by_underlying_.end()) {
+            auto created = std::make_unique<Shard>();
+            created->underlying = underlying;
+            created->listeners = shard_factory_(underlying);
+            created->thread = std::thread(&ShardedReplay::RunShard, this, std::ref(*created));
+            it = shard_by_underlying_.emplace(underlying, created.get()).first;
+            shards_.push_back(std::move(created));
+        }
+        shard = it->second;
+    }
+    return *shard;
+}
+
+ShardedReplay::Event *ShardedReplay::BeginWrite(Shard &shard) {
+    Event *event = shard.ring.BeginWrite();
+    if (event == nullptr) {
+        throw ReplayStopped{};
+    }
+    return event;
+}
+
+void ShardedReplay::Dispatch(const Msg &msg) {
+    for (const TickData &ticker : msg.Updates) {
+        Shard &shard = ShardOf(ticker.InstrumentId);
+        if (shard.open == nullptr) {
+            shard.open = BeginWrite(shard);
+            shard.open->isTimer = false;
+            shard.open->msg.timestamp = msg.timestamp;
+            shard.open->msg.isSnap = msg.isSnap;
+            shard.open->msg.isSet = true;
+            shard.open->msg.Updates.clear();
+            touched_.push_back(&shard);
+        }
+        shard.open->msg.Updates.push_back(ticker);
+    }
+    for (Shard *shard : touched_) {
+        shard->open = nullptr;
+        shard->ring.CommitWrite();
+    }
+    touched_.clear();
+}
+
+void ShardedReplay::BroadcastTimer(uint64_t now_ms) {
+    for (auto &shard : shards_) {
+        Event *event = BeginWrite(*shard);
+        event->isTimer = true;
+        event->now_ms = now_ms;
+        shard->ring.CommitWrite();
+    }
+}
+
+void ShardedReplay::Fail(std::exception_ptr error) {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    if (!error_) {
+        error_ = error;
+    }
+    failed_.store(true);
+}
+
+void ShardedReplay::StopAll() {
+    for (auto &source : sources_) {
+        source->ring.Stop();
+    }
+}
+
+void ShardedReplay::JoinAll() {
+    for (auto &source : sources_) {
+        if (source->thread.joinable()) {
+            source->thread.join();
+        }
+    }
+    for (auto &shard : shards_) {
+        shard->ring.Close();
+        if (shard->thread.joinable()) {
+            shard->thread.join();
+        }
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef QF633_CODE_SHARDEDREPLAY_H
+#define QF633_CODE_SHARDEDREPLAY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Msg.h"
+#include "SpscRing.h"
+
+// Replays tick files with one consumer per underlying (Instrument::Underlying), each on its own thread.
+//
+// Every input file, csv or binary tick log, is parsed on a reader thread. The replay thread merges the files by message
+// timestamp (ties in file order), runs the interval timer of CsvFeeder::Step on the merged stream and splits each
+// message by underlying. A shard receives its part of every message and every timer call from the message that
+// first quoted its underlying on, in stream order, so its listeners see exactly what they would see in a serial
+// replay of the merged stream filtered to that underlying. A snapshot replaces the book of the underlyings it quotes.
+class ShardedReplay
+{
+public:
+    using FeedListener = std::function<void(const Msg &msg)>;
+    using TimerListener = std::function<void(uint64_t ms_now)>;
+    struct Listeners
+    {
+        FeedListener feed;
+        TimerListener timer;
+    };
+    // called on the replay thread when an underlying is first seen; the listeners then run on that shard's thread
+    using ShardFactory = std::function<Listeners(const std::string &underlying)>;
+
+    ShardedReplay(std::vector<std::string> ticker_filenames, ShardFactory shard_factory, std::chrono::minutes interval);
+    ~ShardedReplay();
+    ShardedReplay(const ShardedReplay &) = delete;
+    ShardedReplay &operator=(const ShardedReplay &) = delete;
+
+    // replays every file to the end and returns once all shards are done, rethrowing the first error of any thread
+    void Run();
+    std::size_t NumShards() const { return shards_.size(); }
+
+private:
+    // a message or timer call queued for a shard; slots are recycled, so Msg keeps its capacity
+    struct Event
+    {
+        bool isTimer = false;
+        uint64_t now_ms = 0;
+        Msg msg;
+    };
+    struct Shard
+    {
+        std::string underlying;
+        Listeners listeners;
+        SpscRing<Event> ring{RingSlots};
+        std::thread thread;
+        Event *open = nullptr; // slot being filled for the current message
+    };
+    struct Source
+    {
+        std::string filename;
+        SpscRing<Msg> ring{RingSlots};
+        std::thread thread;
+    };
+    static constexpr std::size_t RingSlots = 64;
+
+    void ReadSource(Source &source);
+    void RunShard(Shard &shard);
+    Shard &ShardOf(instrument_id_t id);
+    void Dispatch(const Msg &msg);
+    void BroadcastTimer(uint64_t now_ms);
+    Event *BeginWrite(Shard &shard);
+    void Fail(std::exception_ptr error);
+    void StopAll();
+    void JoinAll();
+
+    ShardFactory shard_factory_;
+    const std::chrono::milliseconds interval_;
+    std::vector<std::unique_ptr<Source>> sources_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::unordered_map<std::string, Shard *> shard_by_underlying_;
+    std::vector<Shard *> shard_by_id_; // indexed by instrument id, nullptr until resolved
+    std::vector<Shard *> touched_;     // shards with an open slot for the current message
+
+    std::mutex error_mutex_;
+    std::exception_ptr error_;
+    std::atomic<bool> failed_{false}; // set with error_, every thread winds down
+};
+
+#endif // QF633_CODE_SHARDEDREPLAY_H
@@ -0,0 +1,216 @@
+#ifndef QF633_CODE_SIMDMATH_H
+#define QF633_CODE_SIMDMATH_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__))
+#include <immintrin.h>
+#endif
+
+// Minimal SIMD layer for the batch analytics in BSAnalytics.h.
+//
+// Each backend (ScalarOps, Avx2Ops, Avx512Ops) provides the same handful of lane-wise primitives, and the math
+// functions (Exp, Log, ...) are written once on top of them. Every primitive is exactly rounded (or a pure bit
+// manipulation) and the backends evaluate the same operation sequence, so a batch result does not depend on the
+// instruction set it was built for, nor on whether an element landed in a vector lane or in the scalar tail. The one
+// exception is ScalarOps::Fma in a build without fma, which rounds the product: results then differ in the last bits
+// from an fma build, while batch and scalar still agree as ScalarOps is the only backend.
+// NativeOps is the widest backend enabled at compile time (-mavx2 -mfma, -mavx512f, or -march=native).
+namespace simd {
+
+struct ScalarOps {
+    using V = double;
+    using M = bool;
+    static constexpr std::size_t Width = 1;
+    static V Load(const double* p) { return *p; }
+    static void Store(double* p, V v) { *p = v; }
+    static V Set1(double x) { return x; }
+    static V Add(V a, V b) { return a + b; }
+    static V Sub(V a, V b) { return a - b; }
+    static V Mul(V a, V b) { return a * b; }
+    static V Div(V a, V b) { return a / b; }
+#if defined(__FMA__) || defined(FP_FAST_FMA)
+    static V Fma(V a, V b, V c) { return std::fma(a, b, c); }
+#else
+    // std::fma without the instruction is an out-of-line libm call emulating it, many times slower
+    static V Fma(V a, V b, V c) { return a * b + c; }
+#endif
+    static V Sqrt(V a) { return std::sqrt(a); }
+    static V Abs(V a) { return std::fabs(a); }
+    static V Min(V a, V b) { return b < a ? b : a; }
+    static V Max(V a, V b) { return a < b ? b : a; }
+    static V Round(V a) { return std::nearbyint(a); }
+    static M Lt(V a, V b) { return a < b; }
+    static V Select(M m, V a, V b) { return m ? a : b; }
+    // 2^n for integral n in [-1022, 1023]
+    static V Pow2n(V n)
+    {
+        const uint64_t bits = static_cast<uint64_t>(static_cast<int64_t>(n) + 1023) << 52;
+        double r;
+        std::memcpy(&r, &bits, sizeof(r));
+        return r;
+    }
+    // for positive normal x, returns m in [1, 2) and sets e so that x = m * 2^e
+    static V Frexp(V x, V& e)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+        e = static_cast<double>(static_cast<int64_t>(bits >> 52) - 1023);
+        bits = (bits & 0x000FFFFFFFFFFFFFULL) | 0x3FF0000000000000ULL;
+        double m;
+        std::memcpy(&m, &bits, sizeof(m));
+        return m;
+    }
+};
+
+#if defined(__AVX2__) && defined(__FMA__)
+struct Avx2Ops {
+    using V = __m256d;
+    using M = __m256d;
+    static constexpr std::size_t Width = 4;
+    static V Load(const double* p) { return _mm256_loadu_pd(p); }
+    static void Store(double* p, V v) { _mm256_storeu_pd(p, v); }
+    static V Set1(double x) { return _mm256_set1_pd(x); }
+    static V Add(V a, V b) { return _mm256_add_pd(a, b); }
+    static V Sub(V a, V b) { return _mm256_sub_pd(a, b); }
+    static V Mul(V a, V b) { return _mm256_mul_pd(a, b); }
+    static V Div(V a, V b) { return _mm256_div_pd(a, b); }
+    static V Fma(V a, V b, V c) { return _mm256_fmadd_pd(a, b, c); }
+    static V Sqrt(V a) { return _mm256_sqrt_pd(a); }
+    static V Abs(V a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+    static V Min(V a, V b) { return _mm256_min_pd(b, a); }
+    static V Max(V a, V b) { return _mm256_max_pd(b, a); }
+    static V Round(V a) { return _mm256_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static M Lt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static V Select(M m, V a, V b) { return _mm256_blendv_pd(b, a, m); }
+    static V Pow2n(V n)
+    {
+        // n + 1023 + 2^52 has the biased exponent in its low mantissa bits
+        const __m256d shifted = _mm256_add_pd(n, _mm256_set1_pd(4503599627370496.0 + 1023.0));
+        const __m256i biased = _mm256_sub_epi64(_mm256_castpd_si256(shifted), _mm256_castpd_si256(_mm256_set1_pd(4503599627370496.0)));
+        return _mm256_castsi256_pd(_mm256_slli_epi64(biased, 52));
+    }
+    static V Frexp(V x, V& e)
+    {
+        const __m256i bits = _mm256_castpd_si256(x);
+        // the biased exponent placed into the mantissa of 2^52 converts it to double without cvtepi64_pd
+        const __m256i exponent = _mm256_or_si256(_mm256_srli_epi64(bits, 52), _mm256_castpd_si256(_mm256_set1_pd(4503599627370496.0)));
+        e = _mm256_sub_pd(_mm256_castsi256_pd(exponent), _mm256_set1_pd(4503599627370496.0 + 1023.0));
+        const __m256i mantissa = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+                                                 _mm256_set1_epi64x(0x3FF0000000000000LL));
+        return _mm256_castsi256_pd(mantissa);
+    }
+};
+#endif
+
+#if defined(__AVX512F__)
+struct Avx512Ops {
+    using V = __m512d;
+    using M = __mmask8;
+    static constexpr std::size_t Width = 8;
+    static V Load(const double* p) { return _mm512_loadu_pd(p); }
+    static void Store(double* p, V v) { _mm512_storeu_pd(p, v); }
+    static V Set1(double x) { return _mm512_set1_pd(x); }
+    static V Add(V a, V b) { return _mm512_add_pd(a, b); }
+    static V Sub(V a, V b) { return _mm512_sub_pd(a, b); }
+    static V Mul(V a, V b) { return _mm512_mul_pd(a, b); }
+    static V Div(V a, V b) { return _mm512_div_pd(a, b); }
+    static V Fma(V a, V b, V c) { return _mm512_fmadd_pd(a, b, c); }
+    static V Sqrt(V a) { return _mm512_sqrt_pd(a); }
+    static V Abs(V a) { return _mm512_abs_pd(a); }
+    static V Min(V a, V b) { return _mm512_min_pd(b, a); }
+    static V Max(V a, V b) { return _mm512_max_pd(b, a); }
+    static V Round(V a) { return _mm512_roundscale_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static M Lt(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+    static V Select(M m, V a, V b) { return _mm512_mask_blend_pd(m, b, a); }
+    static V Pow2n(V n)
+    {
+        const __m512d shifted = _mm512_add_pd(n, _mm512_set1_pd(4503599627370496.0 + 1023.0));
+        const __m512i biased = _mm512_sub_epi64(_mm512_castpd_si512(shifted), _mm512_castpd_si512(_mm512_set1_pd(4503599627370496.0)));
+        return _mm512_castsi512_pd(_mm512_slli_epi64(biased, 52));
+    }
+    static V Frexp(V x, V& e)
+    {
+        const __m512i bits = _mm512_castpd_si512(x);
+        const __m512i exponent = _mm512_or_si512(_mm512_srli_epi64(bits, 52), _mm512_castpd_si512(_mm512_set1_pd(4503599627370496.0)));
+        e = _mm512_sub_pd(_mm512_castsi512_pd(exponent), _mm512_set1_pd(4503599627370496.0 + 1023.0));
+        const __m512i mantissa = _mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi64(0x000FFFFFFFFFFFFFLL)),
+                                                 _mm512_set1_epi64(0x3FF0000000000000LL));
+        return _mm512_castsi512_pd(mantissa);
+    }
+};
+using NativeOps = Avx512Ops;
+#elif defined(__AVX2__) && defined(__FMA__)
+using NativeOps = Avx2Ops;
+#else
+using NativeOps = ScalarOps;
+#endif
+
+// e^x with a relative error below 2e-16; underflows to 0 below -708.39 and is only meant for x < 709
+template <class Ops>
+typename Ops::V Exp(typename Ops::V x)
+{
+    using V = typename Ops::V;
+    const V clamped = Ops::Max(Ops::Min(x, Ops::Set1(709.0)), Ops::Set1(-708.39));
+    // x = n ln2 + r with |r| <= ln2 / 2, ln2 split in two so n * ln2Hi is exact
+    const V n = Ops::Round(Ops::Mul(clamped, Ops::Set1(1.4426950408889634)));
+    V r = Ops::Fma(n, Ops::Set1(-6.93147180369123816490e-01), clamped);
+    r = Ops::Fma(n, Ops::Set1(-1.90821492927058770002e-10), r);
+    // Taylor series to r^13 / 13!
+    static const double c[] = {1.0 / 6227020800.0, 1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0, 1.0 / 362880.0,
+                               1.0 / 40320.0, 1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0, 0.5, 1.0, 1.0};
+    V p = Ops::Set1(c[0]);
+    for (std::size_t i = 1; i < sizeof(c) / sizeof(c[0]); i++) {
+        p = Ops::Fma(p, r, Ops::Set1(c[i]));
+    }
+    return Ops::Select(Ops::Lt(x, Ops::Set1(-708.39)), Ops::Set1(0.0), Ops::Mul(p, Ops::Pow2n(n)));
+}
+
+// natural log for positive normal x (fdlibm's __ieee754_log reduction and polynomial), error below 1 ulp
+template <class Ops>
+typename Ops::V Log(typename Ops::V x)
+{
+    using V = typename Ops::V;
+    V e;
+    V m = Ops::Frexp(x, e);
+    // center the mantissa around 1: m in [sqrt(2)/2, sqrt(2))
+    const auto large = Ops::Lt(Ops::Set1(1.4142135623730951), m);
+    m = Ops::Select(large, Ops::Mul(m, Ops::Set1(0.5)), m);
+    e = Ops::Select(large, Ops::Add(e, Ops::Set1(1.0)), e);
+
+    const V f = Ops::Sub(m, Ops::Set1(1.0));
+    const V s = Ops::Div(f, Ops::Add(Ops::Set1(2.0), f));
+    const V z = Ops::Mul(s, s);
+    const V w = Ops::Mul(z, z);
+    const V t1 = Ops::Mul(w, Ops::Fma(w, Ops::Fma(w, Ops::Set1(1.531383769920937332e-01), Ops::Set1(2.222219843214978396e-01)),
+                                      Ops::Set1(3.999999999940941908e-01)));
+    const V t2 = Ops::Mul(z, Ops::Fma(w, Ops::Fma(w, Ops::Fma(w, Ops::Set1(1.479819860511658591e-01), Ops::Set1(1.818357216161805012e-01)),
+                                                  Ops::Set1(2.857142874366239149e-01)),
+                                      Ops::Set1(6.666666666666735130e-01)));
+    const V R = Ops::Add(t1, t2);
+    const V hfsq = Ops::Mul(Ops::Set1(0.5), Ops::Mul(f, f));
+    // e ln2Hi - ((hfsq - (s (hfsq + R) + e ln2Lo)) - f)
+    const V inner = Ops::Fma(s, Ops::Add(hfsq, R), Ops::Mul(e, Ops::Set1(1.90821492927058770002e-10)));
+    return Ops::Sub(Ops::Mul(e, Ops::Set1(6.93147180369123816490e-01)), Ops::Sub(Ops::Sub(hfsq, inner), f));
+}
+
+// applies kernel(Ops, const double* in[...], double* out) over n elements, NativeOps for full vectors and
+// ScalarOps for the tail
+template <class Kernel>
+void ForEachBlock(std::size_t n, Kernel&& kernel)
+{
+    std::size_t i = 0;
+    for (; i + NativeOps::Width <= n; i += NativeOps::Width) {
+        kernel(NativeOps{}, i);
+    }
+    for (; i < n; i++) {
+        kernel(ScalarOps{}, i);
+    }
+}
+
+} // namespace simd
+
+#endif // QF633_CODE_SIMDMATH_H
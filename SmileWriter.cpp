@@ -0,0 +1,243 @@
+#include "SmileWriter.h"
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <utility>
+
+#include "Date.h"
+
+namespace {
+
+constexpr uint32_t SmileLogVersion = 1;
+constexpr int NumColumns = 6;
+
+const char *const MonthCodes[] = {"", "JAN", "FEB", "MAR", "APR", "MAY", "JUN", "JUL", "AUG", "SEP", "OCT", "NOV", "DEC"};
+
+// the text of ostream's default double formatting (%g), without the stream
+void AppendDouble(std::string &text, double v) {
+    char buf[32];
+    text.append(buf, std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::general, 6).ptr);
+}
+
+// 2022-05-06T00:01:00.000Z
+void AppendTime(std::string &text, uint64_t ms) {
+    const datetime_t t = datetime_t::FromUnixMS(static_cast<int64_t>(ms));
+    char buf[40];
+    const int n = std::snprintf(buf, sizeof(buf), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ", t.Year(), t.Month(), t.Day(),
+                                t.Hour(), t.Min(), t.Sec(), static_cast<int>(ms % 1000));
+    text.append(buf, n);
+}
+
+// 27-MAY-2022, as DateToTime
+void AppendExpiry(std::string &text, int64_t ms) {
+    const datetime_t d = datetime_t::FromUnixMS(ms);
+    char buf[24];
+    const int n = std::snprintf(buf, sizeof(buf), "%d-%s-%d", d.Day(), MonthCodes[d.Month()], d.Year());
+    text.append(buf, n);
+}
+
+template <class T>
+void WriteColumn(std::ostream &out, const std::vector<SmileRecord> &batch, T (*field)(const SmileRecord &)) {
+    std::vector<T> column(batch.size());
+    for (std::size_t i = 0; i < batch.size(); i++) {
+        column[i] = field(batch[i]);
+    }
+    out.write(reinterpret_cast<const char *>(column.data()), static_cast<std::streamsize>(column.size() * sizeof(T)));
+}
+
+} // namespace
+
+SmileWriter::SmileWriter(SmileWriterOptions options)
+        : options_(std::move(options)) {
+    // opened here, so a bad path fails before the replay rather than at the first batch
+    file_.open(options_.Path, std::ios_base::app | std::ios_base::binary);
+    if (!file_) {
+        throw std::runtime_error("cannot write " + options_.Path);
+    }
+    needsHeader_ = file_.tellp() == 0;
+    front_.reserve(options_.BatchRecords);
+    back_.reserve(options_.BatchRecords);
+    writer_ = std::thread(&SmileWriter::WriterLoop, this);
+}
+
+SmileWriter::~SmileWriter() {
+    try {
+        Close();
+    } catch (...) {
+    }
+}
+
+void SmileWriter::Write(const SmileRecord *records, std::size_t n) {
+    if (closed_) {
+        throw std::logic_error("SmileWriter::Write after Close");
+    }
+    touched_ = true;
+    front_.insert(front_.end(), records, records + n);
+    if (options_.FlushEveryTick || front_.size() >= options_.BatchRecords) {
+        Handover(false);
+    }
+}
+
+void SmileWriter::Close() {
+    if (closed_) {
+        return;
+    }
+    closed_ = true;
+    if (touched_) {
+        Handover(true);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    writer_.join();
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+}
+
+void SmileWriter::Handover(bool last) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (pending_ && !last && front_.size() < 2 * options_.BatchRecords && !options_.FlushEveryTick) {
+        return; // the writer is still busy with the previous batch, keep filling the front buffer
+    }
+    cv_.wait(lock, [this] { return !pending_; });
+    if (error_) {
+        closed_ = true;
+        stop_ = true;
+        cv_.notify_all();
+        lock.unlock();
+        writer_.join();
+        std::rethrow_exception(error_);
+    }
+    std::swap(front_, back_);
+    front_.clear();
+    pending_ = true;
+    cv_.notify_all();
+}
+
+void SmileWriter::WriterLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this] { return pending_ || stop_; });
+        if (!pending_) {
+            break;
+        }
+        lock.unlock();
+        try {
+            if (!error_) {
+                WriteBatch(back_);
+            }
+        } catch (...) {
+            error_ = std::current_exception();
+        }
+        lock.lock();
+        pending_ = false;
+        cv_.notify_all();
+    }
+    if (!error_ && !file_.flush()) {
+        error_ = std::make_exception_ptr(std::runtime_error("cannot write " + options_.Path));
+    }
+}
+
+void SmileWriter::WriteBatch(const std::vector<SmileRecord> &batch) {
+    if (needsHeader_) {
+        needsHeader_ = false;
+        if (options_.Format == SmileFormat::Csv) {
+            file_ << "TIME,EXPIRY,FUT_PRICE,ATM,BF25,RR25,BF10,RR10\n";
+        } else {
+            SmileLogHeader header{};
+            std::memcpy(header.Magic, SmileLogMagic, sizeof(header.Magic));
+            header.Version = SmileLogVersion;
+            file_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        }
+    }
+
+    if (options_.Format == SmileFormat::Csv) {
+        text_.clear();
+        for (const SmileRecord &r : batch) {
+            AppendTime(text_, r.TimeMS);
+            text_ += ',';
+            AppendExpiry(text_, r.ExpiryMS);
+            for (double v : r.Params) {
+                text_ += ',';
+                AppendDouble(text_, v);
+            }
+            text_ += '\n';
+        }
+        file_.write(text_.data(), static_cast<std::streamsize>(text_.size()));
+    } else if (!batch.empty()) {
+        const uint64_t n = batch.size();
+        file_.write(reinterpret_cast<const char *>(&n), sizeof(n));
+        WriteColumn<uint64_t>(file_, batch, [](const SmileRecord &r) { return r.TimeMS; });
+        WriteColumn<int64_t>(file_, batch, [](const SmileRecord &r) { return r.ExpiryMS; });
+        WriteColumn<double>(file_, batch, [](const SmileRecord &r) { return r.Params[0]; });
+        WriteColumn<double>(file_, batch, [](const SmileRecord &r) { return r.Params[1]; });
+        WriteColumn<double>(file_, batch, [](const SmileRecord &r) { return r.Params[2]; });
+        WriteColumn<double>(file_, batch, [](const SmileRecord &r) { return r.Params[3]; });
+        WriteColumn<double>(file_, batch, [](const SmileRecord &r) { return r.Params[4]; });
+        WriteColumn<double>(file_, batch, [](const SmileRecord &r) { return r.Params[5]; });
+        WriteColumn<double>(file_, batch, [](const SmileRecord &r) { return r.FitError; });
+    }
+    if (options_.FlushEveryTick) {
+        file_.flush();
+    }
+    if (!file_) {
+        throw std::runtime_error("cannot write " + options_.Path);
+    }
+
+    if (options_.Log) {
+        text_.clear();
+        for (const SmileRecord &r : batch) {
+            AppendTime(text_, r.TimeMS);
+            text_ += ',';
+            AppendExpiry(text_, r.ExpiryMS);
+            text_ += ",fitting error:";
+            AppendDouble(text_, r.FitError);
+            text_ += '\n';
+        }
+        options_.Log->write(text_.data(), static_cast<std::streamsize>(text_.size()));
+        options_.Log->flush();
+    }
+}
+
+std::vector<SmileRecord> ReadSmileLog(const std::string &filename) {
+    std::ifstream in(filename, std::ios_base::binary);
+    SmileLogHeader header{};
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.Magic, SmileLogMagic, sizeof(header.Magic)) != 0 || header.Version != SmileLogVersion) {
+        throw std::invalid_argument("not a smile log: " + filename);
+    }
+    std::vector<SmileRecord> records;
+    uint64_t n;
+    while (in.read(reinterpret_cast<char *>(&n), sizeof(n))) {
+        const std::size_t begin = records.size();
+        records.resize(begin + n);
+        std::vector<int64_t> ints(n);
+        std::vector<double> doubles(n);
+        auto read = [&in, &filename](void *data, std::size_t bytes) {
+            if (!in.read(static_cast<char *>(data), static_cast<std::streamsize>(bytes))) {
+                throw std::invalid_argument("truncated smile log: " + filename);
+            }
+        };
+        read(ints.data(), n * sizeof(int64_t));
+        for (uint64_t i = 0; i < n; i++) {
+            records[begin + i].TimeMS = static_cast<uint64_t>(ints[i]);
+        }
+        read(ints.data(), n * sizeof(int64_t));
+        for (uint64_t i = 0; i < n; i++) {
+            records[begin + i].ExpiryMS = ints[i];
+        }
+        for (int c = 0; c <= NumColumns; c++) {
+            read(doubles.data(), n * sizeof(double));
+            for (uint64_t i = 0; i < n; i++) {
+                (c < NumColumns ? records[begin + i].Params[c] : records[begin + i].FitError) = doubles[i];
+            }
+        }
+    }
+    return records;
+}
@@ -0,0 +1,92 @@
+#ifndef QF633_CODE_SMILEWRITER_H
+#define QF633_CODE_SMILEWRITER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// one fitted smile of one timer tick, as step3 outputs it
+struct SmileRecord
+{
+    uint64_t TimeMS;   // the timer tick, unix epoch milliseconds
+    int64_t ExpiryMS;  // the expiry date, unix epoch milliseconds
+    double Params[6];  // FUT_PRICE, ATM, BF25, RR25, BF10, RR10
+    double FitError;
+};
+
+enum class SmileFormat
+{
+    Csv,   // TIME,EXPIRY,FUT_PRICE,ATM,BF25,RR25,BF10,RR10 rows, the header written to an empty file only
+    Binary // SmileLogHeader, then blocks of a uint64_t record count followed by one column per SmileRecord field
+};
+
+constexpr char SmileLogMagic[8] = {'Q', 'F', '6', '3', '3', 'S', 'M', '1'};
+
+struct SmileLogHeader
+{
+    char Magic[8];
+    uint32_t Version;
+    uint32_t Reserved;
+};
+
+struct SmileWriterOptions
+{
+    std::string Path;
+    SmileFormat Format = SmileFormat::Csv;
+    // hand every tick to the writer thread and flush the file after it, for following the output live; otherwise
+    // ticks are batched up to BatchRecords and the file is flushed on Close only
+    bool FlushEveryTick = false;
+    std::size_t BatchRecords = 4096;
+    std::ostream *Log = nullptr; // if set, gets a fitting error line per smile, from the writer thread
+};
+
+// Writes fitted smiles on a background thread, so formatting and file I/O stay off the replay thread. Write only
+// copies the records into the front buffer; full batches swap with the back buffer the writer thread drains, and the
+// replay thread waits only if the writer falls a whole batch behind. The constructor opens the file in append mode and
+// throws std::runtime_error if it cannot; the header goes into an empty file with the first batch. Errors of the writer
+// thread are rethrown by the next Write or Close.
+class SmileWriter
+{
+public:
+    explicit SmileWriter(SmileWriterOptions options);
+    ~SmileWriter(); // closes, dropping any error
+    SmileWriter(const SmileWriter &) = delete;
+    SmileWriter &operator=(const SmileWriter &) = delete;
+
+    // the records of one timer tick, in output order; from one thread at a time
+    void Write(const SmileRecord *records, std::size_t n);
+    // writes out everything, flushes and stops the writer thread
+    void Close();
+
+private:
+    void Handover(bool last);
+    void WriterLoop();
+    void WriteBatch(const std::vector<SmileRecord> &batch);
+
+    const SmileWriterOptions options_;
+    std::vector<SmileRecord> front_; // filled by Write
+    std::vector<SmileRecord> back_;  // drained by the writer thread while pending_
+    bool touched_ = false;           // Write was called, the header goes out even without records
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool pending_ = false;
+    bool stop_ = false;
+    bool closed_ = false;
+    std::exception_ptr error_;
+    std::ofstream file_;            // written by the writer thread only, once constructed
+    bool needsHeader_ = false;      // the file was empty when opened
+    std::string text_;              // formatting buffer of the writer thread
+    std::thread writer_;
+};
+
+// reads back a SmileFormat::Binary file, throws std::invalid_argument if it is not one
+std::vector<SmileRecord> ReadSmileLog(const std::string &filename);
+
+#endif // QF633_CODE_SMILEWRITER_H
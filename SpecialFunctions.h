@@ -0,0 +1,210 @@
+#ifndef QF633_CODE_SPECIALFUNCTIONS_H
+#define QF633_CODE_SPECIALFUNCTIONS_H
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+
+#include "SimdMath.h"
+
+// Normal distribution functions to near double precision, written once on the SimdMath.h primitives.
+//
+// NormCdf uses W. J. Cody's rational approximations of erf/erfc (CALERF, three ranges) and InvNormCdf Wichura's
+// AS241 (PPND16, three ranges). The Ops versions evaluate every range and select per lane; the scalar versions branch
+// into the same range functions, so the two agree bit for bit.
+namespace special {
+namespace detail {
+// c[0] x^(N-1) + ... + c[N-1]
+template <class Ops, std::size_t N>
+typename Ops::V Horner(typename Ops::V x, const double (&c)[N])
+{
+    typename Ops::V p = Ops::Set1(c[0]);
+    for (std::size_t i = 1; i < N; i++) {
+        p = Ops::Fma(p, x, Ops::Set1(c[i]));
+    }
+    return p;
+}
+
+// erf(z) for 0 <= z < 0.46875
+template <class Ops>
+typename Ops::V ErfSmall(typename Ops::V z)
+{
+    static const double p[] = {1.85777706184603153e-1, 3.16112374387056560e00, 1.13864154151050156e02,
+                               3.77485237685302021e02, 3.20937758913846947e03};
+    static const double q[] = {1.0, 2.36012909523441209e01, 2.44024637934444173e02, 1.28261652607737228e03,
+                               2.84423683343917062e03};
+    const typename Ops::V y = Ops::Mul(z, z);
+    return Ops::Div(Ops::Mul(z, Horner<Ops>(y, p)), Horner<Ops>(y, q));
+}
+
+// erfc(z) e^{z^2} for 0.46875 <= z < 4
+template <class Ops>
+typename Ops::V ErfcScaledMid(typename Ops::V z)
+{
+    static const double p[] = {2.15311535474403846e-8, 5.64188496988670089e-1, 8.88314979438837594e00,
+                               6.61191906371416295e01, 2.98635138197400131e02, 8.81952221241769090e02,
+                               1.71204761263407058e03, 2.05107837782607147e03, 1.23033935479799725e03};
+    static const double q[] = {1.0, 1.57449261107098347e01, 1.17693950891312499e02, 5.37181101862009858e02,
+                               1.62138957456669019e03, 3.29079923573345963e03, 4.36261909014324716e03,
+                               3.43936767414372164e03, 1.23033935480374942e03};
+    return Ops::Div(Horner<Ops>(z, p), Horner<Ops>(z, q));
+}
+
+// erfc(z) e^{z^2} for z >= 4, asymptotic in 1/z^2
+template <class Ops>
+typename Ops::V ErfcScaledTail(typename Ops::V z)
+{
+    static const double p[] = {1.63153871373020978e-2, 3.05326634961232344e-1, 3.60344899949804439e-1,
+                               1.25781726111229246e-1, 1.60837851487422766e-2, 6.58749161529837803e-4};
+    static const double q[] = {1.0, 2.56852019228982242e00, 1.87295284992346725e00, 5.27905102951428412e-1,
+                               6.05183413124413191e-2, 2.33520497626869185e-3};
+    using V = typename Ops::V;
+    const V y = Ops::Div(Ops::Set1(1.0), Ops::Mul(z, z));
+    const V r = Ops::Div(Ops::Mul(y, Horner<Ops>(y, p)), Horner<Ops>(y, q));
+    return Ops::Div(Ops::Sub(Ops::Set1(5.6418958354775628695e-1), r), z);
+}
+
+// e^{-x^2/2}, with the rounding error of x^2 recovered so the tails keep full relative precision: by an fma, or
+// without one by Veltkamp's split of x into halves whose products are exact (Dekker's two-product)
+template <class Ops>
+typename Ops::V ExpHalfSquare(typename Ops::V x)
+{
+    using V = typename Ops::V;
+    const V hi = Ops::Mul(x, x);
+#if defined(__FMA__) || defined(FP_FAST_FMA)
+    const V lo = Ops::Fma(x, x, Ops::Sub(Ops::Set1(0.0), hi));
+#else
+    const V c = Ops::Mul(Ops::Set1(134217729.0), x); // 2^27 + 1
+    const V xh = Ops::Sub(c, Ops::Sub(c, x));
+    const V xl = Ops::Sub(x, xh);
+    const V lo = Ops::Add(Ops::Add(Ops::Sub(Ops::Mul(xh, xh), hi), Ops::Mul(Ops::Mul(Ops::Set1(2.0), xh), xl)),
+                          Ops::Mul(xl, xl));
+#endif
+    return Ops::Mul(simd::Exp<Ops>(Ops::Mul(Ops::Set1(-0.5), hi)), Ops::Fma(Ops::Set1(-0.5), lo, Ops::Set1(1.0)));
+}
+
+// AS241 central range, |q| <= 0.425 with q = p - 0.5
+template <class Ops>
+typename Ops::V InvNormCentral(typename Ops::V q)
+{
+    static const double a[] = {2509.0809287301226727, 33430.575583588128105, 67265.770927008700853,
+                               45921.953931549871457, 13731.693765509461125, 1971.5909503065514427,
+                               133.14166789178437745, 3.387132872796366608};
+    static const double b[] = {5226.495278852545925, 28729.085735721942674, 39307.89580009271061,
+                               21213.794301586595867, 5394.1960214247511077, 687.1870074920579083,
+                               42.313330701600911252, 1.0};
+    const typename Ops::V r = Ops::Fma(Ops::Sub(Ops::Set1(0.0), q), q, Ops::Set1(0.180625));
+    return Ops::Div(Ops::Mul(q, Horner<Ops>(r, a)), Horner<Ops>(r, b));
+}
+
+// AS241 intermediate range, r = sqrt(-log(min(p, 1 - p))) <= 5
+template <class Ops>
+typename Ops::V InvNormMid(typename Ops::V r)
+{
+    static const double c[] = {7.7454501427834140764e-4, 0.0227238449892691845833, 0.24178072517745061177,
+                               1.27045825245236838258, 3.64784832476320460504, 5.7694972214606914055,
+                               4.6303378461565452959, 1.42343711074968357734};
+    static const double d[] = {1.05075007164441684324e-9, 5.475938084995344946e-4, 0.0151986665636164571966,
+                               0.14810397642748007459, 0.68976733498510000455, 1.6763848301838038494,
+                               2.05319162663775882187, 1.0};
+    const typename Ops::V x = Ops::Sub(r, Ops::Set1(1.6));
+    return Ops::Div(Horner<Ops>(x, c), Horner<Ops>(x, d));
+}
+
+// AS241 far tail, r > 5
+template <class Ops>
+typename Ops::V InvNormTail(typename Ops::V r)
+{
+    static const double e[] = {2.01033439929228813265e-7, 2.71155556874348757815e-5, 0.0012426609473880784386,
+                               0.026532189526576123093, 0.29656057182850489123, 1.7848265399172913358,
+                               5.4637849111641143699, 6.6579046435011037772};
+    static const double f[] = {2.04426310338993978564e-15, 1.4215117583164458887e-7, 1.8463183175100546818e-5,
+                               7.868691311456132591e-4, 0.0148753612908506148525, 0.13692988092273580531,
+                               0.59983220655588793769, 1.0};
+    const typename Ops::V x = Ops::Sub(r, Ops::Set1(5.0));
+    return Ops::Div(Horner<Ops>(x, e), Horner<Ops>(x, f));
+}
+
+template <class Ops>
+typename Ops::V TailRadius(typename Ops::V p)
+{
+    const typename Ops::V m = Ops::Min(p, Ops::Sub(Ops::Set1(1.0), p));
+    return Ops::Sqrt(Ops::Sub(Ops::Set1(0.0), simd::Log<Ops>(m)));
+}
+} // namespace detail
+
+// standard normal cdf, relative error of a few 1e-16 down to the underflow near x = -37.5
+template <class Ops>
+typename Ops::V NormCdf(typename Ops::V x)
+{
+    using V = typename Ops::V;
+    const V z = Ops::Mul(Ops::Abs(x), Ops::Set1(M_SQRT1_2));
+    const auto negative = Ops::Lt(x, Ops::Set1(0.0));
+
+    const V h = Ops::Mul(Ops::Set1(0.5), detail::ErfSmall<Ops>(z));
+    const V central = Ops::Select(negative, Ops::Sub(Ops::Set1(0.5), h), Ops::Add(Ops::Set1(0.5), h));
+
+    const V scaled = Ops::Select(Ops::Lt(z, Ops::Set1(4.0)), detail::ErfcScaledMid<Ops>(z), detail::ErfcScaledTail<Ops>(z));
+    const V t = Ops::Mul(Ops::Mul(Ops::Set1(0.5), detail::ExpHalfSquare<Ops>(x)), scaled);
+    const V tail = Ops::Select(negative, t, Ops::Sub(Ops::Set1(1.0), t));
+    return Ops::Select(Ops::Lt(z, Ops::Set1(0.46875)), central, tail);
+}
+
+inline double NormCdf(double x)
+{
+    using Ops = simd::ScalarOps;
+    const double z = std::fabs(x) * M_SQRT1_2;
+    if (z < 0.46875) {
+        const double h = 0.5 * detail::ErfSmall<Ops>(z);
+        return x < 0 ? 0.5 - h : 0.5 + h;
+    }
+    const double scaled = z < 4.0 ? detail::ErfcScaledMid<Ops>(z) : detail::ErfcScaledTail<Ops>(z);
+    const double t = 0.5 * detail::ExpHalfSquare<Ops>(x) * scaled;
+    return x < 0 ? t : 1.0 - t;
+}
+
+// inverse of NormCdf for p in (DBL_MIN, 1), relative error around 1e-16
+template <class Ops>
+typename Ops::V InvNormCdf(typename Ops::V p)
+{
+    using V = typename Ops::V;
+    const V q = Ops::Sub(p, Ops::Set1(0.5));
+    const V r = detail::TailRadius<Ops>(p);
+    const V tail = Ops::Select(Ops::Lt(Ops::Set1(5.0), r), detail::InvNormTail<Ops>(r), detail::InvNormMid<Ops>(r));
+    const V signedTail = Ops::Select(Ops::Lt(q, Ops::Set1(0.0)), Ops::Sub(Ops::Set1(0.0), tail), tail);
+    return Ops::Select(Ops::Lt(Ops::Set1(0.425), Ops::Abs(q)), signedTail, detail::InvNormCentral<Ops>(q));
+}
+
+inline double InvNormCdf(double p)
+{
+    assert(p > 0 && p < 1);
+    using Ops = simd::ScalarOps;
+    const double q = p - 0.5;
+    if (!(0.425 < std::fabs(q)))
+        return detail::InvNormCentral<Ops>(q);
+    const double r = detail::TailRadius<Ops>(p);
+    const double tail = 5.0 < r ? detail::InvNormTail<Ops>(r) : detail::InvNormMid<Ops>(r);
+    return q < 0 ? -tail : tail;
+}
+
+// out[i] = NormCdf(x[i])
+inline void NormCdfBatch(const double *x, double *out, std::size_t n)
+{
+    simd::ForEachBlock(n, [&](auto ops, std::size_t i) {
+        using Ops = decltype(ops);
+        Ops::Store(out + i, NormCdf<Ops>(Ops::Load(x + i)));
+    });
+}
+
+// out[i] = InvNormCdf(p[i])
+inline void InvNormCdfBatch(const double *p, double *out, std::size_t n)
+{
+    simd::ForEachBlock(n, [&](auto ops, std::size_t i) {
+        using Ops = decltype(ops);
+        Ops::Store(out + i, InvNormCdf<Ops>(Ops::Load(p + i)));
+    });
+}
+} // namespace special
+
+#endif // QF633_CODE_SPECIALFUNCTIONS_H
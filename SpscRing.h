@@ -0,0 +1,66 @@
+#ifndef QF633_CODE_SPSCRING_H
+#define QF633_CODE_SPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Bounded lock-free single-producer/single-consumer queue of pre-allocated slots.
+// Slots are filled and read in place and recycled, so objects owning buffers (e.g. Msg) keep their capacity
+// from one lap to the next. One thread may only call the producer side, one other thread only the consumer side.
+template <class T>
+class SpscRing
+{
+public:
+    explicit SpscRing(std::size_t capacity) : slots_(capacity) {}
+
+    // producer: next free slot, waiting while the ring is full; nullptr once Stop() was called
+    T* BeginWrite()
+    {
+        const uint64_t tail = tail_.load(std::memory_order_relaxed);
+        while (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+            if (stopped_.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+            std::this_thread::yield();
+        }
+        return &slots_[tail % slots_.size()];
+    }
+    // producer: publish the slot returned by BeginWrite
+    void CommitWrite() { tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+    // producer: no more slots will be written
+    void Close() { closed_.store(true, std::memory_order_release); }
+
+    // consumer: oldest published slot, waiting while the ring is empty; nullptr once it is closed and drained
+    T* BeginRead()
+    {
+        const uint64_t head = head_.load(std::memory_order_relaxed);
+        while (head == tail_.load(std::memory_order_acquire)) {
+            if (closed_.load(std::memory_order_acquire)) {
+                // re-check, the producer may have committed right before closing
+                if (head == tail_.load(std::memory_order_acquire)) {
+                    return nullptr;
+                }
+                break;
+            }
+            std::this_thread::yield();
+        }
+        return &slots_[head % slots_.size()];
+    }
+    // consumer: hand the slot returned by BeginRead back to the producer
+    void EndRead() { head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+    // consumer: tell a waiting producer to give up, e.g. when the consumer is destroyed early
+    void Stop() { stopped_.store(true, std::memory_order_release); }
+
+private:
+    std::vector<T> slots_;
+    // producer and consumer indices on separate cache lines to avoid false sharing
+    alignas(64) std::atomic<uint64_t> head_{0};
+    alignas(64) std::atomic<uint64_t> tail_{0};
+    alignas(64) std::atomic<bool> closed_{false};
+    std::atomic<bool> stopped_{false};
+};
+
+#endif // QF633_CODE_SPSCRING_H
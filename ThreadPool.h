@@ -0,0 +1,47 @@
+#ifndef QF633_CODE_THREADPOOL_H
+#define QF633_CODE_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running index loops. ParallelFor hands out indices one at a time from a shared
+// counter, so a worker that finishes a cheap item simply takes the next one and uneven items balance themselves.
+class ThreadPool
+{
+public:
+    // numThreads counts the calling thread, which takes part in every ParallelFor; 0 means hardware concurrency
+    explicit ThreadPool(unsigned numThreads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned Size() const { return static_cast<unsigned>(workers_.size()) + 1; }
+
+    // calls fn(i) for every i in [0, n) and returns when all calls are done, rethrowing the first exception
+    void ParallelFor(std::size_t n, const std::function<void(std::size_t)>& fn);
+
+private:
+    void WorkerLoop();
+    void RunItems();
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    const std::function<void(std::size_t)>* task_ = nullptr;
+    std::size_t num_items_ = 0;
+    std::atomic<std::size_t> next_item_{0};
+    uint64_t generation_ = 0;
+    unsigned busy_workers_ = 0;
+    bool stop_ = false;
+    std::exception_ptr error_;
+};
+
+#endif // QF633_CODE_THREADPOOL_H
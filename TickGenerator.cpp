@@ -0,0 +1,202 @@
+#include "TickGenerator.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "BSAnalytics.h"
+#include "CubicSmile.h"
+
+namespace {
+
+const char *const MonthCodes[] = {"JAN", "FEB", "MAR", "APR", "MAY", "JUN", "JUL", "AUG", "SEP", "OCT", "NOV", "DEC"};
+
+// the strike range of an expiry, in standard deviations of the log strike at the ATM vol; wide enough for the 10
+// delta marks of CubicSmile
+constexpr double MaxStdDevs = 2.5;
+
+} // namespace
+
+TickGenerator::TickGenerator(const TickGeneratorConfig &config)
+        : config_(config),
+          rng_(config.Seed),
+          spot_(config.Spot),
+          spotTime_(config.StartMS),
+          nextArrival_(std::numeric_limits<double>::infinity()),
+          nextSnap_(config.StartMS) {
+    const uint64_t week = 7 * MsPerDay;
+    if (config_.NumExpiries <= 0 || config_.StrikesPerExpiry <= 0) {
+        throw std::invalid_argument("tick generator needs at least one expiry and one strike");
+    }
+    if (config_.DurationMS == 0 || config_.DurationMS >= week) {
+        throw std::invalid_argument("tick generator duration must be less than a week, before the first expiry");
+    }
+    if (!(config_.Spot > 0) || !(config_.SpotVol >= 0) || !(config_.UpdatesPerSecond >= 0) || !(config_.IVSpread >= 0)) {
+        throw std::invalid_argument("tick generator spot must be positive, its vol, the update rate and the spread not negative");
+    }
+
+    // weekly expiries at midnight UTC, the instrument convention of InstrumentRegistry
+    const int64_t startDay = FloorDiv(static_cast<int64_t>(config_.StartMS), MsPerDay) * MsPerDay;
+    char expiry[16], name[64], index[64];
+    for (int e = 0; e < config_.NumExpiries; e++) {
+        const datetime_t expiryDate = datetime_t::FromUnixMS(startDay + (e + 1) * static_cast<int64_t>(week));
+        const double T = YearFraction(expiryDate.UnixMS() - static_cast<int64_t>(config_.StartMS));
+        const double atmVol = config_.AtmVol + config_.AtmVolTermSlope * T;
+        if (!(atmVol > 0)) {
+            throw std::invalid_argument("tick generator ATM vol must stay positive over the expiries");
+        }
+        truth_.push_back({expiryDate, atmVol, config_.Bf25, config_.Rr25, config_.Bf10, config_.Rr10});
+        smiles_.emplace_back(config_.Spot, T, atmVol, config_.Bf25, config_.Rr25, config_.Bf10, config_.Rr10);
+        smileTime_.push_back(config_.StartMS);
+
+        std::snprintf(expiry, sizeof(expiry), "%d%s%02d", expiryDate.Day(), MonthCodes[expiryDate.Month() - 1],
+                      expiryDate.Year() % 100);
+        std::snprintf(index, sizeof(index), "SYN.%s-%s", config_.Underlying.c_str(), expiry);
+        const uint32_t indexId = InstrumentRegistry::Instance().InternIndex(index);
+        double previous = 0;
+        for (int i = 0; i < config_.StrikesPerExpiry; i++) {
+            const double z = config_.StrikesPerExpiry == 1 ? 0 : MaxStdDevs * (2.0 * i / (config_.StrikesPerExpiry - 1) - 1);
+            // whole strikes, as names carry them; dense grids step by one where the rounding collides
+            const double strike = std::max(std::round(config_.Spot * std::exp(atmVol * std::sqrt(T) * z)), previous + 1);
+            previous = strike;
+            for (bool isCall : {true, false}) {
+                std::snprintf(name, sizeof(name), "%s-%s-%.0f-%c", config_.Underlying.c_str(), expiry, strike,
+                              isCall ? 'C' : 'P');
+                contracts_.push_back({InstrumentRegistry::Instance().Intern(name), indexId, isCall, strike,
+                                      static_cast<std::size_t>(e)});
+            }
+        }
+    }
+    if (config_.UpdatesPerSecond > 0) {
+        nextArrival_ = config_.StartMS + 1 - std::log(Uniform()) * 1000 / config_.UpdatesPerSecond;
+    }
+}
+
+double TickGenerator::Uniform() {
+    return ((rng_() >> 11) + 0.5) * 0x1.0p-53;
+}
+
+void TickGenerator::MoveSpot(uint64_t now) {
+    if (config_.SpotVol > 0 && now > spotTime_) {
+        const double dt = YearFraction(static_cast<int64_t>(now - spotTime_));
+        const double s = config_.SpotVol;
+        spot_ *= std::exp(-0.5 * s * s * dt + s * std::sqrt(dt) * invcnorm(Uniform()));
+    }
+    spotTime_ = now;
+}
+
+void TickGenerator::Quote(const Contract &contract, uint64_t now, TickData &tick) {
+    const ExpiryTruth &truth = truth_[contract.Expiry];
+    const double T = YearFraction(truth.Expiry.UnixMS() - static_cast<int64_t>(now));
+    if (smileTime_[contract.Expiry] != now) {
+        smiles_[contract.Expiry] = CubicSmile(spot_, T, truth.AtmVol, truth.Bf25, truth.Rr25, truth.Bf10, truth.Rr10);
+        smileTime_[contract.Expiry] = now;
+    }
+    const double vol = smiles_[contract.Expiry].Vol(contract.Strike);
+    const double bidVol = std::max(vol - config_.IVSpread / 200, 0.001), askVol = vol + config_.IVSpread / 200;
+    const OptionType type = contract.IsCall ? Call : Put;
+
+    tick.InstrumentId = contract.InstrumentId;
+    // prices in units of the underlying, like Deribit's
+    tick.BestBidPrice = bsUndisc(type, contract.Strike, spot_, T, bidVol) / spot_;
+    tick.BestAskPrice = bsUndisc(type, contract.Strike, spot_, T, askVol) / spot_;
+    tick.MarkPrice = bsUndisc(type, contract.Strike, spot_, T, vol) / spot_;
+    tick.BestBidIV = bidVol * 100;
+    tick.BestAskIV = askVol * 100;
+    tick.MarkIV = vol * 100;
+    tick.BestBidAmount = static_cast<double>(1 + (rng_() >> 33) % 100) / 10;
+    tick.BestAskAmount = static_cast<double>(1 + (rng_() >> 33) % 100) / 10;
+    tick.UnderlyingIndexId = contract.UnderlyingIndexId;
+    tick.UnderlyingPrice = spot_;
+    tick.LastPrice = tick.MarkPrice;
+    tick.OpenInterest = static_cast<double>((rng_() >> 33) % 1000);
+    tick.LastUpdateTimeStamp = now;
+}
+
+bool TickGenerator::Next(Msg &msg) {
+    const uint64_t end = config_.StartMS + config_.DurationMS;
+    msg.Updates.clear();
+    msg.isSet = false;
+
+    // a snapshot takes its whole millisecond, updates falling on it move to the next one
+    if (nextSnap_ < end && static_cast<double>(nextSnap_) <= nextArrival_) {
+        const uint64_t now = nextSnap_;
+        MoveSpot(now);
+        msg.Updates.resize(contracts_.size());
+        for (std::size_t i = 0; i < contracts_.size(); i++) {
+            Quote(contracts_[i], now, msg.Updates[i]);
+        }
+        msg.timestamp = now;
+        msg.isSnap = true;
+        msg.isSet = true;
+        nextSnap_ = config_.SnapIntervalMS > 0 ? now + config_.SnapIntervalMS : std::numeric_limits<uint64_t>::max();
+        nextArrival_ = std::max(nextArrival_, static_cast<double>(now + 1));
+        return true;
+    }
+
+    const double nextMs = std::floor(nextArrival_);
+    if (!(nextMs < static_cast<double>(end))) {
+        return false;
+    }
+    const uint64_t now = static_cast<uint64_t>(nextMs);
+    MoveSpot(now);
+    while (std::floor(nextArrival_) == nextMs) {
+        const Contract &contract = contracts_[(rng_() >> 11) % contracts_.size()];
+        Quote(contract, now, msg.Updates.emplace_back());
+        nextArrival_ -= std::log(Uniform()) * 1000 / config_.UpdatesPerSecond;
+    }
+    msg.timestamp = now;
+    msg.isSnap = false;
+    msg.isSet = true;
+    return true;
+}
+
+void WriteTickCsvHeader(std::ostream &out) {
+    out << "contractName,time,msgType,priceCcy,bestBid,bestBidAmount,bestBidIV,bestAsk,bestAskAmount,bestAskIV,"
+           "markPrice,markIV,underlyingIndex,underlyingPrice,interestRate,lastPrice,openInterest\n";
+}
+
+void WriteTickCsvRows(std::ostream &out, const Msg &msg) {
+    const datetime_t time = datetime_t::FromUnixMS(static_cast<int64_t>(msg.timestamp));
+    char ts[80];
+    const int tsSize = std::snprintf(ts, sizeof(ts), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ", time.Year(), time.Month(),
+                                     time.Day(), time.Hour(), time.Min(), time.Sec(), static_cast<int>(msg.timestamp % 1000));
+    const char *msgType = msg.isSnap ? "snap" : "update";
+    const InstrumentRegistry &registry = InstrumentRegistry::Instance();
+    // the rows of the message, written out at once; names of any length just grow it
+    std::string rows;
+    auto text = [&rows](std::string_view s) {
+        rows.append(s);
+        rows += ',';
+    };
+    // 12 significant digits keep the truth to well within the fit tolerance, and within the fast path of ParseDouble
+    auto number = [&rows](double v) {
+        char digits[32]; // at most 19 characters, e.g. -1.23456789012e-308
+        rows.append(digits, std::to_chars(digits, digits + sizeof(digits), v, std::chars_format::general, 12).ptr);
+        rows += ',';
+    };
+    for (const TickData &t : msg.Updates) {
+        const Instrument &instrument = registry.Get(t.InstrumentId);
+        text(instrument.Name);
+        text(std::string_view(ts, tsSize));
+        text(msgType);
+        text(instrument.Underlying);
+        for (double v : {t.BestBidPrice, t.BestBidAmount, t.BestBidIV, t.BestAskPrice, t.BestAskAmount, t.BestAskIV,
+                         t.MarkPrice, t.MarkIV}) {
+            number(v);
+        }
+        text(registry.IndexName(t.UnderlyingIndexId));
+        number(t.UnderlyingPrice);
+        number(0); // interestRate
+        number(t.LastPrice);
+        number(t.OpenInterest);
+        rows.back() = '\n';
+    }
+    out.write(rows.data(), static_cast<std::streamsize>(rows.size()));
+}
@@ -0,0 +1,86 @@
+#ifndef QF633_CODE_TICKGENERATOR_H
+#define QF633_CODE_TICKGENERATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CubicSmile.h"
+#include "Date.h"
+#include "Msg.h"
+
+struct TickGeneratorConfig
+{
+    std::string Underlying = "BTC";
+    uint64_t StartMS = 1651795200000ULL; // 2022-05-06T00:00:00Z
+    uint64_t DurationMS = 3600000;       // generate messages in [StartMS, StartMS + DurationMS)
+    uint64_t SnapIntervalMS = 0;         // a snapshot every SnapIntervalMS after the first one, 0: the first one only
+    int NumExpiries = 8;                 // weekly, the first one week after StartMS
+    int StrikesPerExpiry = 20;           // each quoted as a call and a put
+    double UpdatesPerSecond = 20;        // single contract quote updates, Poisson arrivals over all contracts
+    double Spot = 36000;                 // underlying price at StartMS, also the forward of every expiry
+    double SpotVol = 0.6;                // annualized vol of the driftless underlying path, 0 keeps it at Spot
+    // the smile of every expiry, in the CubicSmile parameters; the ATM vol moves by AtmVolTermSlope per year to expiry
+    double AtmVol = 0.6, Bf25 = 0.01, Rr25 = -0.02, Bf10 = 0.03, Rr10 = -0.04;
+    double AtmVolTermSlope = -0.1;
+    double IVSpread = 2; // bid-ask spread in vol points, around the smile vol
+    uint64_t Seed = 633;
+};
+
+// the smile a generated expiry is quoted from
+struct ExpiryTruth
+{
+    datetime_t Expiry;
+    double AtmVol, Bf25, Rr25, Bf10, Rr10;
+};
+
+// Deterministic Deribit-style option ticks for scale tests: a snapshot of every contract, then quote updates of
+// random contracts while the underlying follows a geometric Brownian motion. Every quote is priced off the expiry's
+// ExpiryTruth smile at the underlying price of its time, so a smile fitted right after a snapshot, or with SpotVol 0,
+// should give back the truth. The same config and seed give the same ticks on any platform.
+class TickGenerator
+{
+public:
+    explicit TickGenerator(const TickGeneratorConfig &config); // throws std::invalid_argument on a bad config
+
+    // the next message in time order, false once past the duration. Rows of one message share its timestamp, like
+    // the ones ReadNextMsg groups.
+    bool Next(Msg &msg);
+
+    const std::vector<ExpiryTruth> &Truth() const { return truth_; }
+    std::size_t NumContracts() const { return contracts_.size(); }
+
+private:
+    struct Contract
+    {
+        instrument_id_t InstrumentId;
+        uint32_t UnderlyingIndexId;
+        bool IsCall;
+        double Strike;
+        std::size_t Expiry; // index into truth_
+    };
+
+    double Uniform(); // in (0, 1)
+    void Quote(const Contract &contract, uint64_t now, TickData &tick);
+    void MoveSpot(uint64_t now);
+
+    TickGeneratorConfig config_;
+    std::vector<ExpiryTruth> truth_;
+    std::vector<Contract> contracts_;
+    std::vector<CubicSmile> smiles_; // the truth of each expiry at the spot of smileTime_
+    std::vector<uint64_t> smileTime_;
+    std::mt19937_64 rng_; // only its raw output is used, the standard distributions differ across libraries
+    double spot_;
+    uint64_t spotTime_;
+    double nextArrival_; // unix ms of the next quote update
+    uint64_t nextSnap_;
+};
+
+// the ticker csv layout ReadNextMsg reads: the header row, and one row per update of msg
+void WriteTickCsvHeader(std::ostream &out);
+void WriteTickCsvRows(std::ostream &out, const Msg &msg);
+
+#endif // QF633_CODE_TICKGENERATOR_H
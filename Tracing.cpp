@@ -0,0 +1,69 @@
+#include "Tracing.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+// appends printf formatted text to out, however long it gets
+template <class... Args>
+void AppendFormat(std::string &out, const char *format, Args... args) {
+    const int n = std::snprintf(nullptr, 0, format, args...);
+    const std::size_t size = out.size();
+    out.resize(size + n + 1);
+    std::snprintf(&out[size], n + 1, format, args...);
+    out.resize(size + n);
+}
+
+} // namespace
+
+Tracer &Tracer::Instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::ThreadBuffer *Tracer::Register() {
+    auto buffer = std::make_unique<ThreadBuffer>();
+    buffer->events.reset(new TraceEvent[EventsPerThread]);
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.push_back(std::move(buffer));
+    return buffers_.back().get();
+}
+
+void Tracer::WriteJson(const std::string &filename) const {
+    std::ofstream out(filename);
+    if (!out) {
+        throw std::runtime_error("cannot write trace file " + filename);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    std::string line;
+    bool first = true;
+    for (std::size_t tid = 0; tid < buffers_.size(); tid++) {
+        const ThreadBuffer &buffer = *buffers_[tid];
+        line.clear();
+        AppendFormat(line, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"thread %zu%s\"}}",
+                     first ? "" : ",\n", tid, tid, buffer.next > EventsPerThread ? ", oldest spans dropped" : "");
+        out << line;
+        first = false;
+        // oldest first, as the ring holds them
+        const uint64_t begin = buffer.next > EventsPerThread ? buffer.next - EventsPerThread : 0;
+        for (uint64_t i = begin; i < buffer.next; i++) {
+            const TraceEvent &e = buffer.events[i % EventsPerThread];
+            line.clear();
+            AppendFormat(line, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f",
+                         e.name, tid, e.beginNs / 1e3, (e.endNs - e.beginNs) / 1e3);
+            if (e.argNames[0]) {
+                AppendFormat(line, ",\"args\":{\"%s\":%lld", e.argNames[0], static_cast<long long>(e.args[0]));
+                if (e.argNames[1]) {
+                    AppendFormat(line, ",\"%s\":%lld", e.argNames[1], static_cast<long long>(e.args[1]));
+                }
+                line += '}';
+            }
+            line += '}';
+            out << line;
+        }
+    }
+    out << "\n]}\n";
+}
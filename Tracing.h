@@ -0,0 +1,89 @@
+#ifndef QF633_CODE_TRACING_H
+#define QF633_CODE_TRACING_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// one timed span on one thread; names are string literals
+struct TraceEvent
+{
+    const char *name;
+    uint64_t beginNs, endNs; // since the tracer started
+    const char *argNames[2]; // null when unused
+    int64_t args[2];
+};
+
+// Records spans into per-thread ring buffers and writes them out as Chrome trace JSON (chrome://tracing, Perfetto).
+// Every thread appends to its own buffer without locking; a full buffer overwrites its oldest spans, so a long replay
+// keeps its tail. WriteJson reads all buffers and must only run once the traced threads are done or joined.
+class Tracer
+{
+public:
+    static constexpr std::size_t EventsPerThread = std::size_t(1) << 18;
+
+    static Tracer &Instance();
+
+    uint64_t NowNs() const
+    {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count());
+    }
+    void Record(const TraceEvent &event)
+    {
+        thread_local ThreadBuffer *buffer = Register();
+        buffer->events[buffer->next++ % EventsPerThread] = event;
+    }
+
+    // writes every recorded span, throws std::runtime_error if the file cannot be written
+    void WriteJson(const std::string &filename) const;
+
+private:
+    struct ThreadBuffer
+    {
+        std::unique_ptr<TraceEvent[]> events;
+        uint64_t next = 0; // total spans recorded, the ring holds the last EventsPerThread
+    };
+
+    Tracer() : start_(std::chrono::steady_clock::now()) {}
+    ThreadBuffer *Register();
+
+    const std::chrono::steady_clock::time_point start_;
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_; // in order of first use, the index is the trace's tid
+};
+
+// records the span of its own lifetime, with up to two integer arguments
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name, const char *argName0 = nullptr, int64_t arg0 = 0,
+                        const char *argName1 = nullptr, int64_t arg1 = 0)
+        : event_{name, Tracer::Instance().NowNs(), 0, {argName0, argName1}, {arg0, arg1}} {}
+    ~TraceScope()
+    {
+        event_.endNs = Tracer::Instance().NowNs();
+        Tracer::Instance().Record(event_);
+    }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    TraceEvent event_;
+};
+
+// Probes tracing the rest of the enclosing scope, with optional (name, value) argument pairs. They compile to nothing
+// unless QF633_ENABLE_TRACING is defined.
+#ifdef QF633_ENABLE_TRACING
+#define QF633_TRACE_CONCAT_(a, b) a##b
+#define QF633_TRACE_CONCAT(a, b) QF633_TRACE_CONCAT_(a, b)
+#define QF633_TRACE_SCOPE(...) TraceScope QF633_TRACE_CONCAT(traceScope_, __LINE__)(__VA_ARGS__)
+#else
+#define QF633_TRACE_SCOPE(...) ((void)0)
+#endif
+
+#endif // QF633_CODE_TRACING_H
@@ -1,10 +1,18 @@
 #ifndef QF633_CODE_VOLSURFBUILDER_HPrintInfo
 #define QF633_CODE_VOLSURFBUILDER_H
 
+#include <algorithm>
 #include <map>
+#include <memory>
+#include <optional>
+#include <vector>
 #include <iomanip>
 #include "Msg.h"
 #include "Date.h"
+#include "LatencyStats.h"
+#include "Tracing.h"
+#include "QuoteStore.h"
+#include "ThreadPool.h"
 
 template <class Smile>
 class VolSurfBuilder
@@ -12,141 +20,189 @@ class VolSurfBuilder
 public:
     void Process(const Msg &msg); // process message
     void PrintInfo();
-    std::map<datetime_t, std::pair<Smile, double>> FitSmiles();
+    // the smile and fitting error of every expiry of every underlying quoted with at least 5 options, in order of
+    // underlying then expiry date
+    std::map<ExpiryKey, std::pair<Smile, double>> FitSmiles();
+    // number of threads FitSmiles fits expiries on (1: serial, the default; 0: hardware concurrency).
+    // The result does not depend on it.
+    void SetFitThreads(unsigned numThreads);
 
 protected:
     // we want to keep the best level information for all instruments
-    // here we use a map from contract name to BestLevelInfo, the key is contract name
-    std::map<std::string, TickData> currentSurfaceRaw;
-    std::map<std::string, int> months = {
-            {"JAN", 1},
-            {"FEB", 2},
-            {"MAR", 3},
-            {"APR", 4},
-            {"MAY", 5},
-            {"JUN", 6},
-            {"JUL", 7},
-            {"AUG", 8},
-            {"SEP", 9},
-            {"OCT", 10},
-            {"NOV", 11},
-            {"DEC", 12}};
-    datetime_t ConvertExpiryToDate(std::string);
-    double GetStrike(const std::string& cName)
+    // here we use a dense vector indexed by instrument id, the contract details live in the InstrumentRegistry.
+    // Slots are never released: a snap only clears the live flags, so at steady state Process does not allocate.
+    std::vector<TickData> currentSurfaceRaw;
+    std::vector<char> isLive;              // isLive[id] is set if currentSurfaceRaw[id] belongs to the current snapshot
+    std::vector<instrument_id_t> liveIds;  // ids with isLive set, in order of arrival
+    // the option quotes of the book again, grouped by expiry in columnar form for smile fitting
+    std::vector<ExpiryQuotes> quotesByExpiry; // indexed by Instrument::ExpiryId
+    std::vector<uint32_t> quoteRow;            // quoteRow[id] is the row of a live option in its ExpiryQuotes
+    void Apply(const TickData &ticker);
+
+    // fits one expiry, warm-started from previous (the last fit of the same expiry) if not null
+    std::pair<Smile, double> FitExpiry(const ExpiryQuotes &quotes, const Smile *previous) const;
+    std::unique_ptr<ThreadPool> fitPool;
+    std::vector<uint32_t> fitExpiries;                      // expiries to fit on this tick, reused across ticks
+    // last fit of every expiry, indexed by ExpiryId. An expiry is dirty once any of its quotes changed since that
+    // fit; FitSmiles only refits dirty expiries and returns the cached smile and error for the others.
+    std::vector<std::optional<std::pair<Smile, double>>> fitCache;
+    std::vector<char> expiryDirty;
+};
+
+template <class Smile>
+void VolSurfBuilder<Smile>::SetFitThreads(unsigned numThreads)
+{
+    fitPool.reset();
+    if (numThreads != 1)
+        fitPool = std::make_unique<ThreadPool>(numThreads);
+}
+
+template <class Smile>
+void VolSurfBuilder<Smile>::Apply(const TickData &ticker)
+{
+    const instrument_id_t id = ticker.InstrumentId;
+    if (id >= currentSurfaceRaw.size())
     {
-        std::size_t firstDashPos = cName.find('-');
-        std::size_t secondDashPos = cName.find('-', firstDashPos + 1);
-        std::size_t thirdDashPos = cName.find('-', secondDashPos + 1);
-        std::string strikeStr = cName.substr(secondDashPos + 1, thirdDashPos - secondDashPos - 1);
-        return std::stod(strikeStr);
+        // first time we see this instrument, grow to cover every id interned so far
+        const std::size_t n = std::max<std::size_t>(id + 1, InstrumentRegistry::Instance().Size());
+        currentSurfaceRaw.resize(n);
+        isLive.resize(n, 0);
+        quoteRow.resize(n, 0);
     }
-};
+    const Instrument &instrument = InstrumentRegistry::Instance().Get(id);
+    if (!isLive[id])
+    {
+        isLive[id] = 1;
+        liveIds.push_back(id);
+        if (instrument.IsOption)
+        {
+            if (instrument.ExpiryId >= quotesByExpiry.size())
+            {
+                const std::size_t numExpiries = InstrumentRegistry::Instance().NumExpiries();
+                quotesByExpiry.resize(numExpiries);
+                fitCache.resize(numExpiries);
+                expiryDirty.resize(numExpiries, 1);
+            }
+            quoteRow[id] = quotesByExpiry[instrument.ExpiryId].Add(id, instrument);
+        }
+    }
+    currentSurfaceRaw[id] = ticker;
+    if (instrument.IsOption)
+    {
+        quotesByExpiry[instrument.ExpiryId].Set(quoteRow[id], ticker);
+        expiryDirty[instrument.ExpiryId] = 1;
+    }
+}
 
 template <class Smile>
 void VolSurfBuilder<Smile>::Process(const Msg &msg)
 {
+    QF633_PROFILE_STAGE(LatencyStage::Process);
+    QF633_TRACE_SCOPE("Process", "isSnap", msg.isSnap, "updates", static_cast<int64_t>(msg.Updates.size()));
     // TODO (Step 2)
     if (msg.isSnap)
     {
-        // discard currently maintained market snapshot, and construct a new copy based on the input Msg
-        currentSurfaceRaw.clear();
-        for (auto &ticker : msg.Updates)
+        // discard currently maintained market snapshot, and construct a new copy based on the input Msg. The last fits
+        // go too, so the fits after a snapshot do not depend on anything before it and a replay can start at any snapshot
+        for (instrument_id_t id : liveIds)
         {
-            currentSurfaceRaw[ticker.ContractName] = ticker;
+            isLive[id] = 0;
         }
-    }
-    else
-    {
-        // update the currently maintained market snapshot
-        for (auto &ticker : msg.Updates)
+        liveIds.clear();
+        for (uint32_t e = 0; e < quotesByExpiry.size(); e++)
         {
-            auto it = currentSurfaceRaw.find(ticker.ContractName);
-            if (it != currentSurfaceRaw.end() && it->second.LastUpdateTimeStamp <= ticker.LastUpdateTimeStamp)
-            {
-                currentSurfaceRaw[ticker.ContractName] = ticker;
-            }
-            else
-            {
-                currentSurfaceRaw[ticker.ContractName] = ticker;
-            }
+            quotesByExpiry[e].Clear();
+            fitCache[e].reset();
+            expiryDirty[e] = 1;
         }
     }
+    // update the currently maintained market snapshot in place
+    for (auto &ticker : msg.Updates)
+    {
+        Apply(ticker);
+    }
 }
 
-
 template <class Smile>
 void VolSurfBuilder<Smile>::PrintInfo() {
     // TODO (Step 2): you may print out information about VolSurfBuilder's currentSnapshot to test
-    std::cout << "Number of contracts in current snapshot: " << currentSurfaceRaw.size() << std::endl;
-    for (const auto& entry : currentSurfaceRaw) {
-        const auto& [contractName, tickData] = entry;
-        std::cout << contractName << "\t, Price= " << tickData.LastPrice << "\t, IV= " << tickData.MarkIV << std::endl;
+    std::cout << "Number of contracts in current snapshot: " << liveIds.size() << std::endl;
+    const InstrumentRegistry& registry = InstrumentRegistry::Instance();
+    for (instrument_id_t id = 0; id < currentSurfaceRaw.size(); id++) {
+        if (!isLive[id])
+            continue;
+        const TickData& tickData = currentSurfaceRaw[id];
+        std::cout << registry.Get(id).Name << "\t, Price= " << tickData.LastPrice << "\t, IV= " << tickData.MarkIV << std::endl;
     }
 }
 
 template <class Smile>
-datetime_t VolSurfBuilder<Smile>::ConvertExpiryToDate(std::string expiry)
+std::pair<Smile, double> VolSurfBuilder<Smile>::FitExpiry(const ExpiryQuotes &quotes, const Smile *previous) const
 {
-    int splitPos = expiry.find('-') + 1;
-    expiry = expiry.substr(splitPos, expiry.length() - splitPos);
-    splitPos = expiry.find('-');
-    expiry = expiry.substr(0, splitPos);
-    int y, m, d;
-    if (expiry.length() == 6)
-    {
-        d = std::stoi(expiry.substr(0, 1));
-        m = months[expiry.substr(1, 3)];
-        y = 2000 + stoi(expiry.substr(4, 2));
+    const std::size_t n = quotes.Size();
+    auto sm = Smile::FitSmile(quotes, previous);
+    double fittingError = 0;
+    double totalWeight = 0;
+    const double *bidIV = quotes.BestBidIV.data();
+    const double *askIV = quotes.BestAskIV.data();
+    // smile vols at all quoted strikes in one batch call; per thread since expiries may be fitted concurrently
+    thread_local std::vector<double> smileIV;
+    smileIV.resize(n);
+    sm.Vol(quotes.Strike.data(), smileIV.data(), n);
+    // Calculate the fitting error with time-based weights
+    for (size_t i = 0; i < n; ++i) {
+        double mIV = (bidIV[i] + askIV[i]) / 200;
+        double sIV = smileIV[i];
+
+        // Calculate the weight based on the time difference from the most recent data point
+        double weight = 1.0 / (i + 1);  // Assign higher weight to more recent data points
+
+        fittingError += weight * (mIV - sIV) * (mIV - sIV);
+        totalWeight += weight;
     }
-    else if (expiry.length() == 7)
-    {
-        d = std::stoi(expiry.substr(0, 2));
-        m = months[expiry.substr(2, 3)];
-        y = 2000 + stoi(expiry.substr(5, 2));
-    }
-    else
-    {
-        std::cerr << "Invalid expiry " << expiry << std::endl;
-        exit(-1);
-    }
-    return datetime_t(y, m, d);
+    fittingError /= totalWeight;
+    return std::pair<Smile, double>(sm, fittingError);
 }
 
 template <class Smile>
-std::map<datetime_t, std::pair<Smile, double>> VolSurfBuilder<Smile>::FitSmiles()
+std::map<ExpiryKey, std::pair<Smile, double>> VolSurfBuilder<Smile>::FitSmiles()
 {
-    std::map<datetime_t, std::vector<TickData>> tickersByExpiry{};
-    // TODO (Step 3): group the tickers in the current market snapshot by expiry date, and construct tickersByExpiry
-    for (const auto& p : currentSurfaceRaw)
+    QF633_PROFILE_STAGE(LatencyStage::FitSmiles);
+    QF633_TRACE_SCOPE("FitSmiles");
+    // the tickers of the current market snapshot are already grouped by expiry in quotesByExpiry, kept up to date by Process
+    fitExpiries.clear();
+    for (uint32_t e = 0; e < quotesByExpiry.size(); e++)
     {
-        const datetime_t expiry_t = ConvertExpiryToDate(p.second.ContractName);
-        tickersByExpiry[expiry_t].push_back(p.second);
+        if (quotesByExpiry[e].Size() < 5)
+            fitCache[e].reset();
+        else if (expiryDirty[e] || !fitCache[e])
+            fitExpiries.push_back(e);
+        expiryDirty[e] = 0;
     }
 
-    std::map<datetime_t, std::pair<Smile, double>> res{};
-    // then create Smile instance for each expiry by calling FitSmile() of the Smile
-    for (auto iter = tickersByExpiry.begin(); iter != tickersByExpiry.end(); iter++)
-    {
-        if (iter->second.size() < 5)
-            continue;
-        auto sm = Smile::FitSmile(iter->second); // TODO: you need to implement FitSmile function in CubicSmile
-        double fittingError = 0;
-        double totalWeight = 0;
-        // Calculate the fitting error with time-based weights
-        for (size_t i = 0; i < iter->second.size(); ++i) {
-            const auto& td = iter->second[i];
-            double mIV = (td.BestBidIV + td.BestAskIV) / 200;
-            double sIV = sm.Vol(GetStrike(td.ContractName));
-
-            // Calculate the weight based on the time difference from the most recent data point
-            double weight = 1.0 / (i + 1);  // Assign higher weight to more recent data points
-
-            fittingError += weight * (mIV - sIV) * (mIV - sIV);
-            totalWeight += weight;
-        }
-        fittingError /= totalWeight;
+    // then create Smile instance for each changed expiry by calling FitSmile() of the Smile, starting from its previous
+    // fit; the fits are independent, each one only reads its own expiry's quotes and its own cache slot, and writes the slot
+    auto fitOne = [this](std::size_t i) {
+        const ExpiryQuotes &quotes = quotesByExpiry[fitExpiries[i]];
+        QF633_PROFILE_STAGE(LatencyStage::FitSmile);
+        QF633_PROFILE_EXPIRY(fitExpiries[i], quotes.Expiry);
+        QF633_TRACE_SCOPE("FitSmile", "expiry", quotes.Expiry.Year() * 10000 + quotes.Expiry.Month() * 100 + quotes.Expiry.Day(),
+                          "quotes", static_cast<int64_t>(quotes.Size()));
+        std::optional<std::pair<Smile, double>> &cached = fitCache[fitExpiries[i]];
+        std::pair<Smile, double> fit = FitExpiry(quotes, cached ? &cached->first : nullptr);
+        cached.emplace(std::move(fit));
+    };
+    if (fitPool)
+        fitPool->ParallelFor(fitExpiries.size(), fitOne);
+    else
+        for (std::size_t i = 0; i < fitExpiries.size(); i++)
+            fitOne(i);
 
-        res.insert(std::pair<datetime_t, std::pair<Smile, double>>(iter->first, std::pair<Smile, double>(sm, fittingError)));
+    std::map<ExpiryKey, std::pair<Smile, double>> res{};
+    for (uint32_t e = 0; e < quotesByExpiry.size(); e++)
+    {
+        if (fitCache[e])
+            res.emplace(ExpiryKey{quotesByExpiry[e].Underlying, quotesByExpiry[e].Expiry}, *fitCache[e]);
     }
     return res;
 }
@@ -154,10 +210,11 @@ std::map<datetime_t, std::pair<Smile, double>> VolSurfBuilder<Smile>::FitSmiles(
 std::string UnixMSToTime(uint64_t t)
 {
     std::time_t tm = static_cast<std::time_t>(t / 1000);
-    std::tm* timeInfo = std::localtime(&tm);
+    std::tm timeInfo;
+    localtime_r(&tm, &timeInfo); // replays may format on several threads
 
     char buffer[24]; // Buffer size for the formatted time string
-    std::strftime(buffer, sizeof(buffer), "%FT%T", timeInfo);
+    std::strftime(buffer, sizeof(buffer), "%FT%T", &timeInfo);
 
     std::stringstream ss;
     ss << buffer << "." << std::setfill('0') << std::setw(3) << (t % 1000) << "Z";
@@ -168,7 +225,7 @@ std::string DateToTime(datetime_t d)
 {
     static std::vector<std::string> month = {"", "JAN", "FEB", "MAR", "APR", "MAY", "JUN", "JUL", "AUG", "SEP", "OCT", "NOV", "DEC"};
     std::string res = "";
-    res += std::to_string(d.day) + "-" + month[d.month] + "-" + std::to_string(d.year);
+    res += std::to_string(d.Day()) + "-" + month[d.Month()] + "-" + std::to_string(d.Year());
     return res;
 }
 
@@ -0,0 +1,146 @@
+#ifndef QF633_CODE_VOLSURFACE_H
+#define QF633_CODE_VOLSURFACE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Date.h"
+#include "Instrument.h"
+
+// Implied vol of one underlying at any time to expiry T and strike K, built from the smiles fitted by
+// VolSurfBuilder::FitSmiles.
+//
+// Between two expiries the total variance Vol^2 T is interpolated linearly in T at constant forward moneyness K / F(T),
+// with the forward F(T) linear in T. Before the first and after the last expiry the vol is flat in T at constant
+// moneyness. Smile needs Vol(strike), the batch Vol(strikes, out, n), Forward() and TimeToExpiry().
+template <class Smile>
+class VolSurface
+{
+public:
+    VolSurface() = default;
+    // from the fits of underlying, ignoring those of any other
+    VolSurface(const std::map<ExpiryKey, std::pair<Smile, double>> &fits, const std::string &underlying);
+
+    double Vol(double T, double K) const;                                 // NaN if the surface is empty
+    void Vol(double T, const double *K, double *out, std::size_t n) const; // out[i] = Vol(T, K[i]), vectorized
+    void Vol(const double *T, const double *K, double *out, std::size_t n) const; // out[i] = Vol(T[i], K[i])
+    std::size_t NumExpiries() const { return smiles.size(); }
+
+private:
+    // where T falls between the expiries: the smiles lo and hi = lo + 1 are read at strike K * scale, and the total
+    // variances combined with weights w (divided by T); lo == hi past either end, where the vol of lo is used as is
+    struct Bracket
+    {
+        std::size_t lo, hi;
+        double scaleLo, scaleHi;
+        double wLo, wHi;
+    };
+    Bracket Locate(double T) const;
+
+    // per expiry, sorted by time to expiry
+    std::vector<double> expiryT;
+    std::vector<double> expiryFwd;
+    std::vector<double> invSpanT; // 1 / (expiryT[i + 1] - expiryT[i])
+    std::vector<Smile> smiles;
+};
+
+template <class Smile>
+VolSurface<Smile>::VolSurface(const std::map<ExpiryKey, std::pair<Smile, double>> &fits, const std::string &underlying)
+{
+    std::vector<const Smile *> sorted;
+    for (const auto &fit : fits)
+        if (fit.first.Underlying == underlying)
+            sorted.push_back(&fit.second.first);
+    // the map is in expiry order, but each smile measured T at its own fit time
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const Smile *a, const Smile *b) { return a->TimeToExpiry() < b->TimeToExpiry(); });
+    for (const Smile *smile : sorted)
+    {
+        // expiries at the same T cannot be interpolated between, keep the first
+        if (!expiryT.empty() && !(smile->TimeToExpiry() > expiryT.back()))
+            continue;
+        expiryT.push_back(smile->TimeToExpiry());
+        expiryFwd.push_back(smile->Forward());
+        smiles.push_back(*smile);
+    }
+    for (std::size_t i = 0; i + 1 < expiryT.size(); i++)
+        invSpanT.push_back(1 / (expiryT[i + 1] - expiryT[i]));
+}
+
+template <class Smile>
+typename VolSurface<Smile>::Bracket VolSurface<Smile>::Locate(double T) const
+{
+    const std::size_t n = expiryT.size();
+    const std::size_t i = std::upper_bound(expiryT.begin(), expiryT.end(), T) - expiryT.begin();
+    if (i == 0 || i == n)
+    {
+        const std::size_t e = i == 0 ? 0 : n - 1;
+        return {e, e, 1, 1, 1, 0};
+    }
+    const std::size_t lo = i - 1;
+    const double w = (T - expiryT[lo]) * invSpanT[lo];
+    const double fwd = expiryFwd[lo] + w * (expiryFwd[i] - expiryFwd[lo]);
+    return {lo, i, expiryFwd[lo] / fwd, expiryFwd[i] / fwd, (1 - w) * expiryT[lo] / T, w * expiryT[i] / T};
+}
+
+template <class Smile>
+double VolSurface<Smile>::Vol(double T, double K) const
+{
+    if (smiles.empty())
+        return std::numeric_limits<double>::quiet_NaN();
+    const Bracket b = Locate(T);
+    const double volLo = smiles[b.lo].Vol(K * b.scaleLo);
+    if (b.lo == b.hi)
+        return volLo;
+    const double volHi = smiles[b.hi].Vol(K * b.scaleHi);
+    return std::sqrt(b.wLo * volLo * volLo + b.wHi * volHi * volHi);
+}
+
+template <class Smile>
+void VolSurface<Smile>::Vol(double T, const double *K, double *out, std::size_t n) const
+{
+    if (smiles.empty())
+    {
+        std::fill(out, out + n, std::numeric_limits<double>::quiet_NaN());
+        return;
+    }
+    const Bracket b = Locate(T);
+    if (b.lo == b.hi)
+    {
+        // out doubles as the strike buffer
+        for (std::size_t i = 0; i < n; i++)
+            out[i] = K[i] * b.scaleLo;
+        smiles[b.lo].Vol(out, out, n);
+        return;
+    }
+    // the arithmetic of the scalar Vol, in chunks small enough to stay in L1
+    constexpr std::size_t Chunk = 256;
+    double volLo[Chunk], volHi[Chunk];
+    for (std::size_t start = 0; start < n; start += Chunk)
+    {
+        const std::size_t m = std::min(Chunk, n - start);
+        for (std::size_t i = 0; i < m; i++)
+        {
+            volLo[i] = K[start + i] * b.scaleLo;
+            volHi[i] = K[start + i] * b.scaleHi;
+        }
+        smiles[b.lo].Vol(volLo, volLo, m);
+        smiles[b.hi].Vol(volHi, volHi, m);
+        for (std::size_t i = 0; i < m; i++)
+            out[start + i] = std::sqrt(b.wLo * volLo[i] * volLo[i] + b.wHi * volHi[i] * volHi[i]);
+    }
+}
+
+template <class Smile>
+void VolSurface<Smile>::Vol(const double *T, const double *K, double *out, std::size_t n) const
+{
+    for (std::size_t i = 0; i < n; i++)
+        out[i] = Vol(T[i], K[i]);
+}
+
+#endif // QF633_CODE_VOLSURFACE_H
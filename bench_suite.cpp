@@ -0,0 +1,272 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Msg.h"
+#include "CsvFeeder.h"
+#include "VolSurfBuilder.h"
+#include "CubicSmile.h"
+#include "BSAnalytics.h"
+#include "BenchUtil.h"
+#include "SmileWriter.h"
+
+// Benchmark suite of the vol pipeline, from timestamp parsing to the end-to-end step3 replay, with results in JSON
+// for comparing commits. Runs on a synthetic capture unless --data names a tick data csv.
+// Usage: bench_suite [--json results.json] [--data tick_data.csv] [--filter name]
+
+namespace {
+
+volatile double sink; // keeps results alive
+
+std::string JsonEscape(const std::string &s)
+{
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+struct Result
+{
+    std::string name;
+    std::string unit;
+    double itemsPerSecond;
+    double nsPerItem;
+};
+
+class Suite
+{
+public:
+    explicit Suite(std::string filter) : filter_(std::move(filter)) {}
+
+    // times f, which processes items units per call
+    template <class F>
+    void Run(const std::string &name, const char *unit, std::size_t items, F &&f)
+    {
+        if (!filter_.empty() && name.find(filter_) == std::string::npos)
+            return;
+        const double seconds = SecondsPerCall(f);
+        results_.push_back({name, unit, items / seconds, seconds / items * 1e9});
+        std::printf("%-40s %12.3f M %s/s %12.1f ns/%s\n", name.c_str(), items / seconds / 1e6, unit,
+                    seconds / items * 1e9, unit);
+    }
+
+    void WriteJson(std::ostream &out, const std::string &data) const
+    {
+        out << "{\n  \"suite\": \"bench_suite\",\n  \"data\": \"" << JsonEscape(data) << "\",\n  \"simd_width\": "
+            << simd::NativeOps::Width << ",\n  \"results\": [\n";
+        char line[512];
+        for (std::size_t i = 0; i < results_.size(); i++) {
+            const Result &r = results_[i];
+            std::snprintf(line, sizeof(line),
+                          "    {\"name\": \"%s\", \"unit\": \"%s\", \"items_per_second\": %.6g, \"ns_per_item\": %.6g}%s\n",
+                          r.name.c_str(), r.unit.c_str(), r.itemsPerSecond, r.nsPerItem,
+                          i + 1 < results_.size() ? "," : "");
+            out << line;
+        }
+        out << "  ]\n}\n";
+    }
+
+private:
+    std::string filter_;
+    std::vector<Result> results_;
+};
+
+std::vector<Msg> LoadMessages(const std::string &path)
+{
+    std::vector<Msg> msgs;
+    CsvFeeder feeder(path, [&msgs](const Msg &msg) { msgs.push_back(msg); }, std::chrono::minutes(1), [](uint64_t) {});
+    while (feeder.Step()) {
+    }
+    return msgs;
+}
+
+void BenchParsing(Suite &suite, const std::string &path, const std::vector<Msg> &msgs)
+{
+    std::vector<std::string> timestamps;
+    char buf[32];
+    for (int i = 0; i < 1000000; i++) {
+        std::snprintf(buf, sizeof(buf), "2022-05-06T%02d:%02d:%02d.%03dZ", i / 3600000 % 24, i / 60000 % 60, i / 1000 % 60,
+                      i % 1000);
+        timestamps.emplace_back(buf);
+    }
+    suite.Run("TimeToUnixMS", "timestamps", timestamps.size(), [&] {
+        uint64_t sum = 0;
+        for (const auto &s : timestamps)
+            sum += TimeToUnixMS(s.data(), s.size());
+        sink = static_cast<double>(sum);
+    });
+
+    std::size_t rows = 0;
+    for (const Msg &msg : msgs)
+        rows += msg.Updates.size();
+    for (CsvReadMode mode : {CsvReadMode::MemoryMapped, CsvReadMode::Stream}) {
+        suite.Run(mode == CsvReadMode::MemoryMapped ? "CsvFeeder rows, memory mapped" : "CsvFeeder rows, stream", "rows",
+                  rows, [&] {
+                      std::size_t n = 0;
+                      CsvFeeder feeder(path, [&n](const Msg &msg) { n += msg.Updates.size(); }, std::chrono::minutes(1),
+                                       [](uint64_t) {}, mode);
+                      while (feeder.Step()) {
+                      }
+                      sink = static_cast<double>(n);
+                  });
+    }
+}
+
+void BenchBuilder(Suite &suite, const std::vector<Msg> &msgs)
+{
+    suite.Run("VolSurfBuilder::Process", "msgs", msgs.size(), [&] {
+        VolSurfBuilder<CubicSmile> builder;
+        for (const Msg &msg : msgs)
+            builder.Process(msg);
+    });
+
+    // every expiry refitted: from scratch after a snapshot, and warm-started after one quote of each changed
+    const int numExpiries = 12;
+    const Msg snap = SyntheticSnap(numExpiries, 40);
+    Msg update;
+    update.isSet = true;
+    update.isSnap = false;
+    for (const TickData &t : snap.Updates)
+        if (update.Updates.empty() ||
+            InstrumentRegistry::Instance().Get(t.InstrumentId).ExpiryId !=
+                InstrumentRegistry::Instance().Get(update.Updates.back().InstrumentId).ExpiryId)
+            update.Updates.push_back(t);
+    VolSurfBuilder<CubicSmile> builder;
+    suite.Run("FitSmiles per expiry, cold", "expiries", numExpiries, [&] {
+        builder.Process(snap);
+        sink = builder.FitSmiles().size();
+    });
+    suite.Run("FitSmiles per expiry, warm", "expiries", numExpiries, [&] {
+        builder.Process(update);
+        sink = builder.FitSmiles().size();
+    });
+}
+
+void BenchAnalytics(Suite &suite)
+{
+    const std::size_t n = 1 << 16;
+    std::mt19937_64 rng(633);
+    std::uniform_real_distribution<double> u(0, 1);
+    std::vector<double> x(n), p(n), strikes(n), fwd(n), T(n), price(n), out(n);
+    std::vector<IVStatus> status(n);
+    for (std::size_t i = 0; i < n; i++) {
+        x[i] = (u(rng) - 0.5) * 16;
+        p[i] = 1e-6 + (1 - 2e-6) * u(rng);
+        fwd[i] = 36000;
+        strikes[i] = fwd[i] * std::exp((u(rng) - 0.5) * 1.5);
+        T[i] = 0.02 + u(rng);
+        price[i] = bsUndisc(Call, strikes[i], fwd[i], T[i], 0.2 + u(rng));
+    }
+
+    suite.Run("cnorm", "calls", n, [&] {
+        for (std::size_t i = 0; i < n; i++)
+            out[i] = cnorm(x[i]);
+    });
+    suite.Run("cnormBatch", "calls", n, [&] { cnormBatch(x.data(), out.data(), n); });
+    suite.Run("invcnorm", "calls", n, [&] {
+        for (std::size_t i = 0; i < n; i++)
+            out[i] = invcnorm(p[i]);
+    });
+    suite.Run("invcnormBatch", "calls", n, [&] { invcnormBatch(p.data(), out.data(), n); });
+    suite.Run("impliedVol", "calls", n, [&] {
+        for (std::size_t i = 0; i < n; i++)
+            out[i] = impliedVol(Call, strikes[i], fwd[i], T[i], price[i]);
+    });
+    suite.Run("impliedVolBatch", "calls", n, [&] {
+        impliedVolBatch(Call, strikes.data(), fwd.data(), T.data(), price.data(), out.data(), status.data(), n);
+    });
+
+    const CubicSmile smile(36000, 0.25, 0.6, 0.02, -0.03, 0.06, -0.08);
+    suite.Run("CubicSmile::Vol", "queries", n, [&] {
+        for (std::size_t i = 0; i < n; i++)
+            out[i] = smile.Vol(strikes[i]);
+    });
+    suite.Run("CubicSmile::Vol batch", "queries", n, [&] { smile.Vol(strikes.data(), out.data(), n); });
+    sink = out[n / 2];
+}
+
+// step3 end to end: pipelined csv replay, book building, smile fitting every minute and the csv output through
+// SmileWriter, into a temporary file
+void BenchReplay(Suite &suite, const std::string &path, std::size_t numMsgs)
+{
+    const std::string outPath = (std::filesystem::temp_directory_path() / "qf633_bench_suite_smiles.csv").string();
+    suite.Run("step3 replay", "msgs", numMsgs, [&] {
+        std::filesystem::remove(outPath);
+        VolSurfBuilder<CubicSmile> volBuilder;
+        SmileWriterOptions options;
+        options.Path = outPath;
+        SmileWriter writer(options);
+        std::vector<SmileRecord> records;
+        CsvFeeder feeder(path, [&volBuilder](const Msg &msg) { volBuilder.Process(msg); }, std::chrono::minutes(1),
+                         [&volBuilder, &writer, &records](uint64_t now_ms) {
+                             records.clear();
+                             for (const auto &sm : volBuilder.FitSmiles()) {
+                                 SmileRecord &r = records.emplace_back();
+                                 r.TimeMS = now_ms;
+                                 r.ExpiryMS = sm.first.Expiry.UnixMS();
+                                 std::copy(sm.second.first.params.begin(), sm.second.first.params.end(), r.Params);
+                                 r.FitError = sm.second.second;
+                             }
+                             writer.Write(records.data(), records.size());
+                         },
+                         CsvReadMode::MemoryMapped, true);
+        while (feeder.Step()) {
+        }
+        writer.Close();
+    });
+    sink = static_cast<double>(std::filesystem::file_size(outPath));
+    std::filesystem::remove(outPath);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::string jsonPath, dataPath, filter;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--json") == 0)
+            jsonPath = argv[i + 1];
+        else if (std::strcmp(argv[i], "--data") == 0)
+            dataPath = argv[i + 1];
+        else if (std::strcmp(argv[i], "--filter") == 0)
+            filter = argv[i + 1];
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--json results.json] [--data tick_data.csv] [--filter name]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    std::string path = dataPath;
+    if (path.empty()) {
+        path = (std::filesystem::temp_directory_path() / "qf633_bench_suite.csv").string();
+        WriteTickCsv(path, SyntheticStream({"BTC"}, 12, 40, 20000));
+    }
+    const std::vector<Msg> msgs = LoadMessages(path);
+
+    Suite suite(filter);
+    BenchParsing(suite, path, msgs);
+    BenchBuilder(suite, msgs);
+    BenchAnalytics(suite);
+    BenchReplay(suite, path, msgs.size());
+
+    if (dataPath.empty())
+        std::filesystem::remove(path);
+    if (!jsonPath.empty()) {
+        std::ofstream out(jsonPath);
+        suite.WriteJson(out, dataPath.empty() ? "synthetic" : dataPath);
+    }
+    return 0;
+}
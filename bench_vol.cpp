@@ -0,0 +1,375 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Msg.h"
+#include "VolSurfBuilder.h"
+#include "CubicSmile.h"
+#include "VolSurface.h"
+#include "GreeksEngine.h"
+#include "ShardedReplay.h"
+#include "CsvFeeder.h"
+#include "BSAnalytics.h"
+#include "BenchUtil.h"
+
+// Benchmarks for the vol pipeline on a synthetic surface, no market data needed.
+// Usage: bench_vol [numExpiries] [strikesPerExpiry] [maxThreads]
+
+namespace {
+
+// fits warm-started from different histories stop at slightly different points of the same optimum
+bool SameFits(const std::map<ExpiryKey, std::pair<CubicSmile, double>> &a,
+              const std::map<ExpiryKey, std::pair<CubicSmile, double>> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (auto ia = a.begin(), ib = b.begin(); ia != a.end(); ++ia, ++ib) {
+        if (!(ia->first == ib->first))
+            return false;
+        for (std::size_t j = 0; j < ia->second.first.params.size(); j++)
+            if (!(std::fabs(ia->second.first.params[j] - ib->second.first.params[j]) <= 1e-6))
+                return false;
+        if (!(std::fabs(ia->second.second - ib->second.second) <= 1e-9))
+            return false;
+    }
+    return true;
+}
+
+ExpiryQuotes QuotesOf(const Msg &msg)
+{
+    ExpiryQuotes quotes;
+    for (const TickData &t : msg.Updates)
+        quotes.Set(quotes.Add(t.InstrumentId, InstrumentRegistry::Instance().Get(t.InstrumentId)), t);
+    return quotes;
+}
+
+void BenchFitSmilesScaling(int numExpiries, int strikesPerExpiry, unsigned maxThreads)
+{
+    VolSurfBuilder<CubicSmile> builder;
+    const Msg snap = SyntheticSnap(numExpiries, strikesPerExpiry);
+    builder.Process(snap);
+    const auto serial = builder.FitSmiles();
+
+    std::cout << "FitSmiles scaling, " << numExpiries << " expiries x " << strikesPerExpiry * 2 << " quotes" << std::endl;
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+    double base = 0;
+    for (unsigned threads : threadCounts) {
+        builder.SetFitThreads(threads);
+        builder.Process(snap);
+        bool identical = SameFits(serial, builder.FitSmiles());
+        // re-applying the snap marks every expiry dirty, so each call refits the whole surface
+        const double s = SecondsPerCall([&] {
+            builder.Process(snap);
+            builder.FitSmiles();
+        });
+        if (threads == 1)
+            base = s;
+        std::printf("  threads=%-3u %9.1f us/FitSmiles  speedup %.2fx  %s\n", threads, s * 1e6, base / s,
+                    identical ? "identical" : "MISMATCH");
+    }
+}
+
+// refit cost when only one expiry had quote updates since the previous tick
+void BenchIncrementalRefit(int numExpiries, int strikesPerExpiry)
+{
+    VolSurfBuilder<CubicSmile> builder;
+    const Msg snap = SyntheticSnap(numExpiries, strikesPerExpiry);
+    Msg update;
+    update.isSet = true;
+    update.isSnap = false;
+    update.Updates.push_back(snap.Updates.front());
+
+    const double full = SecondsPerCall([&] {
+        builder.Process(snap);
+        builder.FitSmiles();
+    });
+    builder.Process(snap);
+    const double incremental = SecondsPerCall([&] {
+        builder.Process(update);
+        builder.FitSmiles();
+    });
+    builder.Process(snap);
+    const bool identical = SameFits(builder.FitSmiles(), [&] {
+        VolSurfBuilder<CubicSmile> fresh;
+        fresh.Process(snap);
+        return fresh.FitSmiles();
+    }());
+    std::printf("Incremental refit, 1 of %d expiries dirty: %.1f us vs %.1f us full refit (%.1fx)  %s\n", numExpiries,
+                incremental * 1e6, full * 1e6, full / incremental, identical ? "identical" : "MISMATCH");
+}
+
+// the original bsUndisc, on the Abramowitz-Stegun 7.1.26 cnorm (absolute error 1.5e-7), as the baseline for the scalar
+double BaselineBsUndisc(double k, double fwd, double T, double sigma)
+{
+    auto cnorm = [](double x) {
+        const double z = std::fabs(x) / std::sqrt(2.0), t = 1.0 / (1.0 + 0.3275911 * z);
+        const double y = 1.0 - (((((1.061405429 * t - 1.453152027) * t) + 1.421413741) * t - 0.284496736) * t + 0.254829592) *
+                                   t * std::exp(-z * z);
+        return 0.5 * (1.0 + (x < 0 ? -y : y));
+    };
+    const double sigmaSqrtT = sigma * std::sqrt(T);
+    const double d1 = std::log(fwd / k) / sigmaSqrtT + 0.5 * sigmaSqrtT;
+    return fwd * cnorm(d1) - k * cnorm(d1 - sigmaSqrtT);
+}
+
+// scalar bsUndisc in a loop vs the baseline and vs bsUndiscBatch over the same arrays
+void BenchBatchBlackScholes(std::size_t n)
+{
+    std::vector<double> k(n), fwd(n, 36000), T(n), sigma(n), out(n);
+    for (std::size_t i = 0; i < n; i++) {
+        k[i] = 20000 + 40000.0 * i / n;
+        T[i] = 0.01 + 0.5 * (i % 97) / 97.0;
+        sigma[i] = 0.4 + 0.4 * (i % 13) / 13.0;
+    }
+    const double scalar = SecondsPerCall([&] {
+        for (std::size_t i = 0; i < n; i++)
+            out[i] = bsUndisc(Call, k[i], fwd[i], T[i], sigma[i]);
+    });
+    const double baseline = SecondsPerCall([&] {
+        for (std::size_t i = 0; i < n; i++)
+            out[i] = BaselineBsUndisc(k[i], fwd[i], T[i], sigma[i]);
+    });
+    const double batch = SecondsPerCall([&] { bsUndiscBatch(Call, k.data(), fwd.data(), T.data(), sigma.data(), out.data(), n); });
+#if defined(__FMA__) || defined(FP_FAST_FMA)
+    const char *fma = "fma";
+#else
+    const char *fma = "no fma";
+#endif
+    std::printf("bsUndisc (%s): scalar %.1f M options/s vs baseline %.1f M options/s (%.2fx), batch (width %zu) %.1f M "
+                "options/s (%.1fx)\n",
+                fma, n / scalar / 1e6, n / baseline / 1e6, baseline / scalar, simd::NativeOps::Width, n / batch / 1e6,
+                scalar / batch);
+}
+
+// FitSmile from scratch vs warm-started from the fit before a small move of all quotes
+void BenchWarmStart(int strikesPerExpiry)
+{
+    const ExpiryQuotes before = QuotesOf(SyntheticSnap(1, strikesPerExpiry));
+    ExpiryQuotes after = before;
+    for (std::size_t i = 0; i < after.Size(); i++) {
+        const double bump = 0.3 + 0.002 * (after.Strike[i] - after.UnderlyingPrice[i]) / 100;
+        after.BestBidIV[i] += bump;
+        after.BestAskIV[i] += bump;
+    }
+    const CubicSmile previous = CubicSmile::FitSmile(before);
+    const double cold = SecondsPerCall([&] { CubicSmile::FitSmile(after); });
+    const double warm = SecondsPerCall([&] { CubicSmile::FitSmile(after, &previous); });
+    const CubicSmile a = CubicSmile::FitSmile(after), b = CubicSmile::FitSmile(after, &previous);
+    double diff = 0;
+    for (std::size_t j = 0; j < a.params.size(); j++)
+        diff = std::max(diff, std::fabs(a.params[j] - b.params[j]));
+    std::printf("FitSmile, %d quotes: cold %.1f us, warm-started %.1f us (%.1fx), max param difference %.1e\n",
+                strikesPerExpiry * 2, cold * 1e6, warm * 1e6, cold / warm, diff);
+}
+
+// CubicSmile::Vol one strike at a time vs the batch overload, strikes in random order
+void BenchSmileVol(std::size_t n)
+{
+    const CubicSmile smile(36000, 0.25, 0.6, 0.02, -0.03, 0.06, -0.08);
+    std::vector<double> strikes(n), out(n), outBatch(n);
+    uint64_t state = 633;
+    for (std::size_t i = 0; i < n; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        strikes[i] = 10000 + 60000.0 * (state >> 11) / 9007199254740992.0;
+    }
+    const double scalar = SecondsPerCall([&] {
+        for (std::size_t i = 0; i < n; i++)
+            out[i] = smile.Vol(strikes[i]);
+    });
+    const double batch = SecondsPerCall([&] { smile.Vol(strikes.data(), outBatch.data(), n); });
+    const bool identical = std::memcmp(out.data(), outBatch.data(), n * sizeof(double)) == 0;
+    std::printf("CubicSmile::Vol: scalar %.1f M strikes/s, batch %.1f M strikes/s (%.1fx)  %s\n", n / scalar / 1e6,
+                n / batch / 1e6, scalar / batch, identical ? "identical" : "MISMATCH");
+}
+
+// Brent (impliedVolBrent) vs the Householder solver, scalar and batch, on the same prices
+void BenchImpliedVol(std::size_t n)
+{
+    std::vector<double> k(n), fwd(n, 36000), T(n), sigma(n), price(n), vol(n);
+    std::vector<IVStatus> status(n);
+    for (std::size_t i = 0; i < n; i++) {
+        T[i] = 0.01 + 0.5 * (i % 97) / 97.0;
+        sigma[i] = 0.4 + 0.4 * (i % 13) / 13.0;
+        // within 3 standard deviations, beyond that cnorm's accuracy rather than the solver limits the round trip
+        k[i] = fwd[i] * std::exp(sigma[i] * std::sqrt(T[i]) * (6.0 * i / n - 3));
+    }
+    bsUndiscBatch(Call, k.data(), fwd.data(), T.data(), sigma.data(), price.data(), n);
+    double brentErr = 0, solveErr = 0;
+    for (std::size_t i = 0; i < n; i++) {
+        brentErr = std::max(brentErr, std::fabs(impliedVolBrent(Call, k[i], fwd[i], T[i], price[i]) - sigma[i]));
+        solveErr = std::max(solveErr, std::fabs(impliedVol(Call, k[i], fwd[i], T[i], price[i]) - sigma[i]));
+    }
+    const double brent = SecondsPerCall([&] {
+        for (std::size_t i = 0; i < n; i++)
+            vol[i] = impliedVolBrent(Call, k[i], fwd[i], T[i], price[i]);
+    });
+    const double scalar = SecondsPerCall([&] {
+        for (std::size_t i = 0; i < n; i++)
+            vol[i] = impliedVol(Call, k[i], fwd[i], T[i], price[i]);
+    });
+    const double batch = SecondsPerCall([&] { impliedVolBatch(Call, k.data(), fwd.data(), T.data(), price.data(), vol.data(), status.data(), n); });
+    std::printf("impliedVol: Brent %.2f M/s (max error %.1e), Householder scalar %.2f M/s (%.1fx, max error %.1e), batch %.2f M/s (%.1fx)\n",
+                n / brent / 1e6, brentErr, n / scalar / 1e6, brent / scalar, solveErr, n / batch / 1e6, brent / batch);
+}
+
+// VolSurface queries at random (T, K) and along one maturity, on the fitted synthetic surface
+void BenchVolSurface(int numExpiries, int strikesPerExpiry, std::size_t n)
+{
+    VolSurfBuilder<CubicSmile> builder;
+    builder.Process(SyntheticSnap(numExpiries, strikesPerExpiry));
+    const auto fits = builder.FitSmiles();
+    const VolSurface<CubicSmile> surface(fits, "BTC");
+    const double maxT = 7.0 * (numExpiries + 1) / 365;
+
+    std::vector<double> T(n), strikes(n), out(n), outBatch(n);
+    uint64_t state = 633;
+    auto uniform = [&state] {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (state >> 11) / 9007199254740992.0;
+    };
+    for (std::size_t i = 0; i < n; i++) {
+        T[i] = maxT * uniform();
+        strikes[i] = 10000 + 60000.0 * uniform();
+    }
+    const double scalar = SecondsPerCall([&] {
+        for (std::size_t i = 0; i < n; i++)
+            out[i] = surface.Vol(T[i], strikes[i]);
+    });
+    const double sliceT = T[0];
+    for (std::size_t i = 0; i < n; i++)
+        out[i] = surface.Vol(sliceT, strikes[i]);
+    const double batch = SecondsPerCall([&] { surface.Vol(sliceT, strikes.data(), outBatch.data(), n); });
+    bool identical = std::memcmp(out.data(), outBatch.data(), n * sizeof(double)) == 0;
+    // on an expiry the surface is that expiry's smile
+    for (const auto &fit : fits) {
+        const CubicSmile &smile = fit.second.first;
+        identical = identical && surface.Vol(smile.TimeToExpiry(), 36000) == smile.Vol(36000);
+    }
+    std::printf("VolSurface::Vol over %zu expiries: %.1f ns per (T, K) query, %.1f ns per strike along one T  %s\n",
+                surface.NumExpiries(), scalar / n * 1e9, batch / n * 1e9, identical ? "consistent" : "MISMATCH");
+}
+
+// GreeksEngine::Compute over a random portfolio of the synthetic contracts, per thread count
+void BenchGreeks(int numExpiries, int strikesPerExpiry, std::size_t numPositions, unsigned maxThreads)
+{
+    VolSurfBuilder<CubicSmile> builder;
+    const Msg snap = SyntheticSnap(numExpiries, strikesPerExpiry);
+    builder.Process(snap);
+    const auto fits = builder.FitSmiles();
+
+    std::vector<Position> positions(numPositions);
+    uint64_t state = 633;
+    for (Position &p : positions) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        p.ContractName = InstrumentRegistry::Instance().Get(snap.Updates[(state >> 33) % snap.Updates.size()].InstrumentId).Name;
+        p.Quantity = static_cast<double>((state >> 20) % 21) - 10;
+    }
+    GreeksEngine<CubicSmile> engine;
+    engine.SetPortfolio(positions);
+    PortfolioGreeks serial, parallel;
+    const double base = SecondsPerCall([&] { engine.Compute(fits, serial); });
+    std::printf("GreeksEngine, %zu positions: 1 thread %.1f M positions/s", numPositions, numPositions / base / 1e6);
+    for (unsigned threads = 2; threads <= maxThreads; threads *= 2) {
+        engine.SetThreads(threads);
+        const double t = SecondsPerCall([&] { engine.Compute(fits, parallel); });
+        std::printf(", %u threads %.1f M/s (%.2fx)", threads, numPositions / t / 1e6, base / t);
+    }
+    const bool identical = std::memcmp(&serial.Total, &parallel.Total, sizeof(BSGreeks)) == 0;
+    std::printf("  %s\n", maxThreads < 2 || identical ? "identical" : "MISMATCH");
+}
+
+// a builder logging every fit, one log per underlying
+struct ReplayShard
+{
+    VolSurfBuilder<CubicSmile> builder;
+    std::map<std::string, std::string> logs;
+    void Timer(uint64_t now_ms)
+    {
+        char line[256];
+        for (const auto &fit : builder.FitSmiles()) {
+            const std::vector<double> &p = fit.second.first.params;
+            const datetime_t &expiry = fit.first.Expiry;
+            std::snprintf(line, sizeof(line), "%llu,%d-%d-%d,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g\n",
+                          static_cast<unsigned long long>(now_ms), expiry.Year(), expiry.Month(), expiry.Day(), p[0],
+                          p[1], p[2], p[3], p[4], p[5], fit.second.second);
+            logs[fit.first.Underlying] += line;
+        }
+    }
+};
+
+// ShardedReplay against a serial replay of the same csv through one builder, as step3 runs it; returns whether the
+// sharded replay fitted the same smiles as the serial one
+bool BenchShardedReplay(int numUnderlyings, int numExpiries, int strikesPerExpiry, int numUpdates)
+{
+    static const char *names[] = {"BTC", "ETH", "SOL", "XRP", "BNB", "ADA", "DOGE", "AVAX"};
+    const std::vector<const char *> underlyings(names, names + std::min(numUnderlyings, 8));
+    const std::string path = (std::filesystem::temp_directory_path() / "qf633_bench_replay.csv").string();
+    WriteTickCsv(path, SyntheticStream(underlyings, numExpiries, strikesPerExpiry, numUpdates));
+    const auto interval = std::chrono::minutes(1);
+
+    std::unique_ptr<ReplayShard> serial;
+    const double serialSeconds = SecondsPerCall(
+        [&] {
+            serial = std::make_unique<ReplayShard>();
+            CsvFeeder feeder(path, [&](const Msg &msg) { serial->builder.Process(msg); }, interval,
+                             [&](uint64_t now_ms) { serial->Timer(now_ms); });
+            while (feeder.Step()) {
+            }
+        },
+        1, 0);
+
+    std::map<std::string, std::unique_ptr<ReplayShard>> sharded;
+    const double shardedSeconds = SecondsPerCall(
+        [&] {
+            sharded.clear();
+            ShardedReplay replay({path}, [&](const std::string &underlying) {
+                ReplayShard *shard = (sharded[underlying] = std::make_unique<ReplayShard>()).get();
+                return ShardedReplay::Listeners{[shard](const Msg &msg) { shard->builder.Process(msg); },
+                                                [shard](uint64_t now_ms) { shard->Timer(now_ms); }};
+            }, interval);
+            replay.Run();
+        },
+        1, 0);
+    std::filesystem::remove(path);
+
+    std::map<std::string, std::string> shardedLogs;
+    for (const auto &shard : sharded)
+        shardedLogs.insert(shard.second->logs.begin(), shard.second->logs.end());
+    const bool identical = !serial->logs.empty() && shardedLogs == serial->logs;
+    std::printf("ShardedReplay, %zu underlyings, %d updates: %.1f k msgs/s vs %.1f k msgs/s serial (%.2fx)  %s\n",
+                underlyings.size(), numUpdates, numUpdates / shardedSeconds / 1e3, numUpdates / serialSeconds / 1e3,
+                serialSeconds / shardedSeconds, identical ? "identical" : "MISMATCH");
+    return identical;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const int numExpiries = argc > 1 ? std::atoi(argv[1]) : 12;
+    const int strikesPerExpiry = argc > 2 ? std::atoi(argv[2]) : 40;
+    const unsigned maxThreads = argc > 3 ? std::atoi(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+    BenchFitSmilesScaling(numExpiries, strikesPerExpiry, maxThreads);
+    BenchIncrementalRefit(numExpiries, strikesPerExpiry);
+    BenchBatchBlackScholes(1 << 20);
+    BenchWarmStart(strikesPerExpiry);
+    BenchImpliedVol(1 << 16);
+    BenchSmileVol(1 << 20);
+    BenchVolSurface(numExpiries, strikesPerExpiry, 1 << 20);
+    BenchGreeks(numExpiries, strikesPerExpiry, 10000, maxThreads);
+    BenchGreeks(numExpiries, strikesPerExpiry, 100000, maxThreads);
+    // a benchmark that stops reproducing the serial replay fails the run
+    return BenchShardedReplay(4, numExpiries, strikesPerExpiry, 20000) ? 0 : 1;
+}
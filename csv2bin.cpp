@@ -0,0 +1,17 @@
+#include <iostream>
+
+#include "BinaryTickLog.h"
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: "
+                  << argv[0] << " tick_data.csv"
+                  << " tick_data.bin" << std::endl;
+        return 1;
+    }
+    const auto numRecords = ConvertCsvToBinaryTickLog(argv[1], argv[2]);
+    std::cout << "wrote " << numRecords << " records to " << argv[2] << std::endl;
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "TickGenerator.h"
+#include "VolSurfBuilder.h"
+
+// Writes a synthetic tick data csv for step1/step2/step3, and optionally the smiles it was quoted from in the
+// parameters step3 writes, to check its fits against.
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc % 2 != 0)
+    {
+        std::cerr << "Usage: " << argv[0] << " tick_data.csv"
+                  << " [--expiries N] [--strikes N] [--rate updatesPerSecond] [--minutes N] [--snap-minutes N]"
+                  << " [--spot X] [--spot-vol X] [--underlying BTC] [--seed N] [--truth truth.csv]" << std::endl;
+        return 1;
+    }
+
+    TickGeneratorConfig config;
+    std::string truthFile;
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        const std::string flag = argv[i];
+        const char *value = argv[i + 1];
+        if (flag == "--expiries")
+            config.NumExpiries = std::atoi(value);
+        else if (flag == "--strikes")
+            config.StrikesPerExpiry = std::atoi(value);
+        else if (flag == "--rate")
+            config.UpdatesPerSecond = std::atof(value);
+        else if (flag == "--minutes")
+            config.DurationMS = static_cast<uint64_t>(std::atof(value) * 60000);
+        else if (flag == "--snap-minutes")
+            config.SnapIntervalMS = static_cast<uint64_t>(std::atof(value) * 60000);
+        else if (flag == "--spot")
+            config.Spot = std::atof(value);
+        else if (flag == "--spot-vol")
+            config.SpotVol = std::atof(value);
+        else if (flag == "--underlying")
+            config.Underlying = value;
+        else if (flag == "--seed")
+            config.Seed = std::strtoull(value, nullptr, 10);
+        else if (flag == "--truth")
+            truthFile = value;
+        else
+        {
+            std::cerr << "unknown option " << flag << std::endl;
+            return 1;
+        }
+    }
+
+    TickGenerator generator(config);
+    std::ofstream out(argv[1]);
+    WriteTickCsvHeader(out);
+    Msg msg;
+    std::size_t numMsgs = 0, numRows = 0;
+    while (generator.Next(msg))
+    {
+        WriteTickCsvRows(out, msg);
+        numMsgs++;
+        numRows += msg.Updates.size();
+    }
+    std::cout << "wrote " << numRows << " rows in " << numMsgs << " messages of " << generator.NumContracts()
+              << " contracts to " << argv[1] << std::endl;
+
+    if (!truthFile.empty())
+    {
+        std::ofstream truth(truthFile);
+        truth << "EXPIRY,ATM,BF25,RR25,BF10,RR10" << std::endl;
+        for (const ExpiryTruth &t : generator.Truth())
+        {
+            truth << DateToTime(t.Expiry) << "," << t.AtmVol << "," << t.Bf25 << "," << t.Rr25 << "," << t.Bf10 << ","
+                  << t.Rr10 << std::endl;
+        }
+    }
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include <iostream>
 
 #include "CsvFeeder.h"
+#include "BinaryFeeder.h"
 #include "Msg.h"
 
 int main(int argc, char **argv)
@@ -27,13 +28,16 @@ int main(int argc, char **argv)
     };
 
     const auto interval = std::chrono::minutes(1); // we call timer_listener at 1 minute interval
-    CsvFeeder csv_feeder(ticker_filename,
-                         feeder_listener,
-                         interval,
-                         timer_listener);
-
-    while (csv_feeder.Step())
+    // tick_data may be a csv capture or a binary tick log produced by csv2bin
+    auto replay = [](auto &&feeder)
     {
-    }
+        while (feeder.Step())
+        {
+        }
+    };
+    if (IsBinaryTickLog(ticker_filename))
+        replay(BinaryFeeder(ticker_filename, feeder_listener, interval, timer_listener));
+    else
+        replay(CsvFeeder(ticker_filename, feeder_listener, interval, timer_listener));
     return 0;
 }
\ No newline at end of file
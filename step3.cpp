@@ -1,20 +1,130 @@
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
 #include <iostream>
+#include <memory>
+#include <vector>
 
 #include "CsvFeeder.h"
+#include "LatencyStats.h"
+#include "Tracing.h"
+#include "BinaryFeeder.h"
+#include "PartitionedReplay.h"
 #include "Msg.h"
 #include "VolSurfBuilder.h"
 #include "CubicSmile.h"
+#include "SmileWriter.h"
 
-int main(int argc, char **argv)
+#ifdef QF633_ENABLE_TRACING
+// the timeline of the replay, for chrome://tracing or Perfetto, to $QF633_TRACE_FILE or trace.json
+void WriteTrace()
 {
-    if (argc < 3)
+    const char *filename = std::getenv("QF633_TRACE_FILE");
+    Tracer::Instance().WriteJson(filename ? filename : "trace.json");
+}
+#endif
+
+#ifdef QF633_ENABLE_PROFILING
+// prints the latencies so far when the replayed time enters a new hour, whatever the timer interval
+void DumpLatenciesHourly(uint64_t now_ms, uint64_t &lastHour)
+{
+    const uint64_t hour = now_ms / 3600000;
+    if (hour != lastHour)
     {
-        std::cerr << "Usage: "
-                  << argv[0] << " tick_data.csv"
-                  << " outputFile.csv" << std::endl;
-        return 1;
+        if (lastHour != 0)
+        {
+            LatencyStats::Instance().Dump(std::cerr, now_ms);
+        }
+        lastHour = hour;
+    }
+}
+#endif
+
+// fit smiles and append them to records
+void FitRecords(VolSurfBuilder<CubicSmile> &volBuilder, uint64_t now_ms, std::vector<SmileRecord> &records)
+{
+    for (const auto &sm : volBuilder.FitSmiles())
+    {
+        SmileRecord &r = records.emplace_back();
+        r.TimeMS = now_ms;
+        r.ExpiryMS = sm.first.Expiry.UnixMS();
+        std::copy(sm.second.first.params.begin(), sm.second.first.params.end(), r.Params);
+        r.FitError = sm.second.second;
+    }
+}
+
+// backtestThreads >= 0: replay a csv split at its snapshots on this many threads (0: all cores), same output
+int Replay(const char *ticker_filename, const char *output_filename, int backtestThreads)
+{
+    // smiles and their fitting error go out on a writer thread; outputFile.bin selects the binary columnar format
+    SmileWriterOptions options;
+    options.Path = output_filename;
+    if (options.Path.size() > 4 && options.Path.compare(options.Path.size() - 4, 4, ".bin") == 0)
+    {
+        options.Format = SmileFormat::Binary;
+    }
+    options.Log = &std::cout;
+    SmileWriter writer(options);
+
+    const auto interval = std::chrono::minutes(1); // we call timer_listener at 1 minute interval
+    if (backtestThreads >= 0 && !IsBinaryTickLog(ticker_filename))
+    {
+        // every chunk fits on its own builder into its own buffers, written out in chunk order
+        PartitionedReplay replay(ticker_filename, interval);
+        std::vector<std::unique_ptr<VolSurfBuilder<CubicSmile>>> builders(replay.NumChunks());
+        std::vector<std::vector<SmileRecord>> records(replay.NumChunks());
+        std::vector<char> timed(replay.NumChunks(), 0); // the serial replay creates the output on the first timer call
+#ifdef QF633_ENABLE_PROFILING
+        uint64_t lastDumpHour = 0;
+#endif
+        auto make_listeners = [&](std::size_t chunk)
+        {
+            builders[chunk] = std::make_unique<VolSurfBuilder<CubicSmile>>();
+            VolSurfBuilder<CubicSmile> *volBuilder = builders[chunk].get();
+            return PartitionedReplay::Listeners{
+                [volBuilder](const Msg &msg)
+                {
+                    if (msg.isSet)
+                    {
+                        volBuilder->Process(msg);
+                    }
+                },
+                [volBuilder, &records, &timed, chunk](uint64_t now_ms)
+                {
+                    timed[chunk] = 1;
+                    FitRecords(*volBuilder, now_ms, records[chunk]);
+                }};
+        };
+        auto chunk_done = [&](std::size_t chunk)
+        {
+            builders[chunk].reset();
+            if (timed[chunk])
+            {
+                writer.Write(records[chunk].data(), records[chunk].size());
+            }
+#ifdef QF633_ENABLE_PROFILING
+            // chunks finish in order, but the histograms also hold the chunks still running
+            if (!records[chunk].empty())
+            {
+                if (lastDumpHour == 0)
+                {
+                    DumpLatenciesHourly(records[chunk].front().TimeMS, lastDumpHour); // the hour the replay starts in
+                }
+                DumpLatenciesHourly(records[chunk].back().TimeMS, lastDumpHour);
+            }
+#endif
+            records[chunk] = std::vector<SmileRecord>();
+        };
+        replay.Run(static_cast<unsigned>(backtestThreads), make_listeners, chunk_done);
+        writer.Close();
+#ifdef QF633_ENABLE_PROFILING
+        LatencyStats::Instance().Dump(std::cerr);
+#endif
+#ifdef QF633_ENABLE_TRACING
+        WriteTrace();
+#endif
+        return 0;
     }
-    const char *ticker_filename = argv[1];
 
     VolSurfBuilder<CubicSmile> volBuilder;
     auto feeder_listener = [&volBuilder](const Msg &msg)
@@ -25,41 +135,63 @@ int main(int argc, char **argv)
         }
     };
 
-    auto timer_listener = [&volBuilder](uint64_t now_ms)
+    std::vector<SmileRecord> records;
+#ifdef QF633_ENABLE_PROFILING
+    uint64_t lastDumpHour = 0;
+#endif
+    auto timer_listener = [&](uint64_t now_ms)
     {
-        // fit smile
-        auto smiles = volBuilder.FitSmiles();
-        // TODO: stream the smiles and their fitting error to outputFile.csv
-        static std::ofstream fout;
-        if (!fout.is_open())
+        records.clear();
+        FitRecords(volBuilder, now_ms, records);
         {
-            fout.open("TestData/outputFile.csv", std::ios_base::app); // Open the file in append mode
-            if (fout.tellp() == 0) // Check if the file is empty
-            {
-                fout << "TIME,EXPIRY,FUT_PRICE,ATM,BF25,RR25,BF10,RR10" << std::endl; // Write the header only if the file is empty
-            }
+            QF633_PROFILE_STAGE(LatencyStage::Output);
+            QF633_TRACE_SCOPE("Output", "smiles", static_cast<int64_t>(records.size()));
+            writer.Write(records.data(), records.size());
         }
+#ifdef QF633_ENABLE_PROFILING
+        DumpLatenciesHourly(now_ms, lastDumpHour);
+#endif
+    };
 
-        for (const auto &sm : smiles)
+    // tick_data may be a csv capture or a binary tick log produced by csv2bin
+    auto replay = [](auto &&feeder)
+    {
+        while (feeder.Step())
         {
-            fout << UnixMSToTime(now_ms) << "," << DateToTime(sm.first);
-            for (const double v : sm.second.first.params)
-            {
-                fout << "," << v;
-            }
-            fout << std::endl;
-
-            std::cout << UnixMSToTime(now_ms) << "," << DateToTime(sm.first) << ",fitting error:" << sm.second.second << std::endl;
         }
     };
+    if (IsBinaryTickLog(ticker_filename))
+        replay(BinaryFeeder(ticker_filename, feeder_listener, interval, timer_listener));
+    else
+        replay(CsvFeeder(ticker_filename, feeder_listener, interval, timer_listener,
+                         CsvReadMode::MemoryMapped, true)); // parse ahead on a second core while smiles are fitted
+    writer.Close();
+#ifdef QF633_ENABLE_PROFILING
+    LatencyStats::Instance().Dump(std::cerr);
+#endif
+#ifdef QF633_ENABLE_TRACING
+    WriteTrace();
+#endif
+    return 0;
+}
 
-    const auto interval = std::chrono::minutes(1); // we call timer_listener at 1 minute interval
-    CsvFeeder csv_feeder(ticker_filename,
-                         feeder_listener,
-                         interval,
-                         timer_listener);
-    while (csv_feeder.Step())
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: "
+                  << argv[0] << " tick_data.csv"
+                  << " outputFile.csv"
+                  << " [backtestThreads]" << std::endl;
+        return 1;
+    }
+    try
     {
+        return Replay(argv[1], argv[2], argc > 3 ? std::atoi(argv[3]) : -1);
     }
-    return 0;
-}
\ No newline at end of file
+    catch (const std::exception &e)
+    {
+        std::cerr << argv[0] << ": " << e.what() << std::endl;
+        return 1;
+    }
+}
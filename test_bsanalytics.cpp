@@ -0,0 +1,385 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "BSAnalytics.h"
+#include "CubicSmile.h"
+#include "GreeksEngine.h"
+#include "VolSurface.h"
+
+// Accuracy checks for the analytics in BSAnalytics.h, VolSurface.h and GreeksEngine.h; returns non-zero if any check fails.
+
+namespace {
+
+int failures = 0;
+
+void Check(const char *name, double maxError, double tolerance)
+{
+    const bool ok = maxError <= tolerance;
+    std::cout << (ok ? "ok    " : "FAILED") << " " << name << ": max error " << maxError << " (tolerance " << tolerance << ")" << std::endl;
+    failures += !ok;
+}
+
+double RelativeError(double a, double b)
+{
+    return std::fabs(a - b) / std::max(std::fabs(b), 1e-300);
+}
+
+void TestSimdMath(std::mt19937_64 &rng)
+{
+    std::uniform_real_distribution<double> expArg(-700, 700);
+    std::uniform_real_distribution<double> logExp(-300, 300);
+    double expErr = 0, logErr = 0;
+    for (int i = 0; i < 1000000; i++) {
+        const double x = expArg(rng);
+        expErr = std::max(expErr, RelativeError(simd::Exp<simd::ScalarOps>(x), std::exp(x)));
+        const double y = std::pow(10.0, logExp(rng));
+        logErr = std::max(logErr, std::fabs(simd::Log<simd::ScalarOps>(y) - std::log(y)) / std::max(1.0, std::fabs(std::log(y))));
+    }
+    Check("simd::Exp vs std::exp (relative)", expErr, 4e-16);
+    Check("simd::Log vs std::log", logErr, 4e-16);
+    Check("simd::Exp underflow", simd::Exp<simd::ScalarOps>(-800.0), 0.0);
+}
+
+// long double references: 0.5 erfc(-x / sqrt 2), and its inverse by Newton from the double result
+long double NormCdfRef(long double x)
+{
+    return 0.5L * std::erfc(-x / std::sqrt(2.0L));
+}
+
+long double InvNormCdfRef(double p, double guess)
+{
+    long double x = guess;
+    for (int i = 0; i < 3; i++)
+        x -= (NormCdfRef(x) - p) / (std::exp(-0.5L * x * x) / std::sqrt(2 * 3.14159265358979323846264338327950288L));
+    return x;
+}
+
+void TestSpecialFunctions(std::mt19937_64 &rng)
+{
+    // NormCdf from the underflow threshold to where it rounds to 1
+    double err = 0;
+    for (double x = -37.5; x < 9; x += 1e-4)
+        err = std::max(err, static_cast<double>(std::fabs((cnorm(x) - NormCdfRef(x)) / NormCdfRef(x))));
+    Check("cnorm vs long double (relative)", err, 2e-15);
+
+    // InvNormCdf over uniform p and p spread log-uniformly down to 1e-300
+    std::uniform_real_distribution<double> u(0, 1);
+    const std::size_t n = 100003;
+    std::vector<double> p(n), out(n), outTail(n);
+    for (std::size_t i = 0; i < n; i++) {
+        p[i] = i % 2 ? u(rng) : std::pow(10.0, -300 * u(rng));
+        if (p[i] == 0)
+            p[i] = 0.5;
+    }
+    err = 0;
+    for (std::size_t i = 0; i < n; i++) {
+        const double x = invcnorm(p[i]);
+        err = std::max(err, static_cast<double>(std::fabs((x - InvNormCdfRef(p[i], x)) / InvNormCdfRef(p[i], x))));
+    }
+    Check("invcnorm vs long double (relative)", err, 2e-15);
+
+    // batch versions are bit-identical to the scalar ones, in vector lanes and in the scalar tail
+    invcnormBatch(p.data(), out.data(), n);
+    for (std::size_t i = 0; i < n; i++)
+        invcnormBatch(&p[i], &outTail[i], 1);
+    err = 0;
+    for (std::size_t i = 0; i < n; i++)
+        err = std::max({err, std::fabs(out[i] - invcnorm(p[i])), std::fabs(outTail[i] - invcnorm(p[i]))});
+    Check("invcnormBatch vs invcnorm", err, 0.0);
+
+    for (std::size_t i = 0; i < n; i++)
+        p[i] = (u(rng) - 0.5) * 70;
+    cnormBatch(p.data(), out.data(), n);
+    for (std::size_t i = 0; i < n; i++)
+        cnormBatch(&p[i], &outTail[i], 1);
+    err = 0;
+    for (std::size_t i = 0; i < n; i++)
+        err = std::max({err, std::fabs(out[i] - cnorm(p[i])), std::fabs(outTail[i] - cnorm(p[i]))});
+    Check("cnormBatch vs cnorm", err, 0.0);
+}
+
+void TestBatchBlackScholes(std::mt19937_64 &rng)
+{
+    const std::size_t n = 100003; // not a multiple of any vector width, exercises the scalar tail
+    std::uniform_real_distribution<double> u(0, 1);
+    std::vector<double> k(n), fwd(n), T(n), sigma(n), out(n), outTail(n);
+    std::vector<OptionType> types(n);
+    for (std::size_t i = 0; i < n; i++) {
+        fwd[i] = 100 + 50000 * u(rng);
+        k[i] = fwd[i] * std::exp((u(rng) - 0.5) * 3);
+        T[i] = 1e-3 + 2 * u(rng);
+        sigma[i] = 0.05 + 2 * u(rng);
+        types[i] = u(rng) < 0.5 ? Call : Put;
+    }
+
+    for (OptionType type : {Call, Put}) {
+        bsUndiscBatch(type, k.data(), fwd.data(), T.data(), sigma.data(), out.data(), n);
+        double err = 0;
+        for (std::size_t i = 0; i < n; i++)
+            err = std::max(err, std::fabs(out[i] - bsUndisc(type, k[i], fwd[i], T[i], sigma[i])) / fwd[i]);
+        Check(type == Call ? "bsUndiscBatch(Call) vs bsUndisc (relative to fwd)" : "bsUndiscBatch(Put) vs bsUndisc (relative to fwd)", err, 1e-14);
+    }
+
+    bsUndiscBatch(types.data(), k.data(), fwd.data(), T.data(), sigma.data(), out.data(), n);
+    double err = 0;
+    for (std::size_t i = 0; i < n; i++)
+        err = std::max(err, std::fabs(out[i] - bsUndisc(types[i], k[i], fwd[i], T[i], sigma[i])) / fwd[i]);
+    Check("bsUndiscBatch(mixed) vs bsUndisc (relative to fwd)", err, 1e-14);
+
+    // the vector lanes and the scalar tail must give bit-identical results
+    for (std::size_t i = 0; i < n; i++)
+        bsUndiscBatch(&types[i], &k[i], &fwd[i], &T[i], &sigma[i], &outTail[i], 1);
+    err = 0;
+    for (std::size_t i = 0; i < n; i++)
+        err = std::max(err, std::fabs(out[i] - outTail[i]));
+    Check("bsUndiscBatch vector lanes vs scalar tail", err, 0.0);
+}
+
+void TestGreeks(std::mt19937_64 &rng)
+{
+    const std::size_t n = 10007;
+    std::uniform_real_distribution<double> u(0, 1);
+    std::vector<double> k(n), sigma(n), price(n), delta(n), gamma(n), vega(n), theta(n);
+    std::vector<OptionType> types(n);
+    const double fwd = 36000, T = 0.3;
+    for (std::size_t i = 0; i < n; i++) {
+        k[i] = fwd * std::exp((u(rng) - 0.5) * 2);
+        sigma[i] = 0.1 + 1.5 * u(rng);
+        types[i] = u(rng) < 0.5 ? Call : Put;
+    }
+
+    // against central differences of bsUndisc, each Greek scaled to a dimensionless size
+    double errPrice = 0, errDelta = 0, errGamma = 0, errVega = 0, errTheta = 0;
+    for (std::size_t i = 0; i < n; i++) {
+        const BSGreeks g = bsGreeks(types[i], k[i], fwd, T, sigma[i]);
+        auto v = [&](double f, double t, double s) { return bsUndisc(types[i], k[i], f, t, s); };
+        const double hf = 1e-4 * fwd, ht = 1e-5, hs = 1e-5;
+        errPrice = std::max(errPrice, std::fabs(g.price - v(fwd, T, sigma[i])) / fwd);
+        errDelta = std::max(errDelta, std::fabs(g.delta - (v(fwd + hf, T, sigma[i]) - v(fwd - hf, T, sigma[i])) / (2 * hf)));
+        errGamma = std::max(errGamma, fwd * std::fabs(g.gamma - (v(fwd + hf, T, sigma[i]) - 2 * v(fwd, T, sigma[i]) + v(fwd - hf, T, sigma[i])) / (hf * hf)));
+        errVega = std::max(errVega, std::fabs(g.vega - (v(fwd, T, sigma[i] + hs) - v(fwd, T, sigma[i] - hs)) / (2 * hs)) / fwd);
+        errTheta = std::max(errTheta, std::fabs(g.theta + (v(fwd, T + ht, sigma[i]) - v(fwd, T - ht, sigma[i])) / (2 * ht)) / fwd);
+    }
+    Check("bsGreeks price vs bsUndisc (relative to fwd)", errPrice, 1e-15);
+    Check("bsGreeks delta vs finite difference", errDelta, 1e-6);
+    Check("bsGreeks gamma vs finite difference (times fwd)", errGamma, 1e-5);
+    Check("bsGreeks vega vs finite difference (relative to fwd)", errVega, 1e-8);
+    Check("bsGreeks theta vs finite difference (relative to fwd)", errTheta, 1e-8);
+
+    // the batch is the scalar function lane by lane
+    bsGreeksBatch(types.data(), k.data(), fwd, T, sigma.data(), price.data(), delta.data(), gamma.data(), vega.data(),
+                  theta.data(), n);
+    double err = 0;
+    for (std::size_t i = 0; i < n; i++) {
+        const BSGreeks g = bsGreeks(types[i], k[i], fwd, T, sigma[i]);
+        err = std::max({err, std::fabs(price[i] - g.price), std::fabs(delta[i] - g.delta), std::fabs(gamma[i] - g.gamma),
+                        std::fabs(vega[i] - g.vega), std::fabs(theta[i] - g.theta)});
+    }
+    Check("bsGreeksBatch vs bsGreeks", err, 0.0);
+}
+
+void TestImpliedVol(std::mt19937_64 &rng)
+{
+    const std::size_t n = 100003;
+    std::uniform_real_distribution<double> u(0, 1);
+    std::vector<double> k(n), fwd(n), T(n), sigma(n), price(n), vol(n), volTail(n);
+    std::vector<IVStatus> status(n), statusTail(n);
+    for (std::size_t i = 0; i < n; i++) {
+        fwd[i] = 100 + 50000 * u(rng);
+        T[i] = 1e-3 + 2 * u(rng);
+        sigma[i] = 0.05 + 2 * u(rng);
+        // up to 3 standard deviations either side of the forward
+        k[i] = fwd[i] * std::exp(sigma[i] * std::sqrt(T[i]) * 6 * (u(rng) - 0.5));
+    }
+
+    for (OptionType type : {Call, Put}) {
+        bsUndiscBatch(type, k.data(), fwd.data(), T.data(), sigma.data(), price.data(), n);
+        double err = 0;
+        std::size_t notOk = 0;
+        for (std::size_t i = 0; i < n; i++) {
+            const IVResult r = impliedVolSolve(type, k[i], fwd[i], T[i], price[i]);
+            if (r.status != IVStatus::Ok)
+                notOk++;
+            else
+                err = std::max(err, RelativeError(r.vol, sigma[i]));
+        }
+        Check(type == Call ? "impliedVolSolve(Call) round trip (relative)" : "impliedVolSolve(Put) round trip (relative)", err, 1e-10);
+        Check("impliedVolSolve failures", notOk, 0);
+
+        impliedVolBatch(type, k.data(), fwd.data(), T.data(), price.data(), vol.data(), status.data(), n);
+        for (std::size_t i = 0; i < n; i++)
+            impliedVolBatch(type, &k[i], &fwd[i], &T[i], &price[i], &volTail[i], &statusTail[i], 1);
+        err = 0;
+        for (std::size_t i = 0; i < n; i++) {
+            const IVResult r = impliedVolSolve(type, k[i], fwd[i], T[i], price[i]);
+            if (status[i] != r.status || statusTail[i] != r.status || std::memcmp(&vol[i], &r.vol, sizeof(double)) != 0 ||
+                std::memcmp(&volTail[i], &r.vol, sizeof(double)) != 0)
+                err++;
+        }
+        Check("impliedVolBatch vector lanes and scalar tail vs impliedVolSolve, mismatches", err, 0);
+    }
+
+    const double f = 36000, t = 0.25;
+    Check("impliedVolSolve below intrinsic", impliedVolSolve(Call, 30000, f, t, 5999).status != IVStatus::BelowIntrinsic, 0);
+    Check("impliedVolSolve above maximum", impliedVolSolve(Put, 30000, f, t, 30000).status != IVStatus::AboveMaximum, 0);
+    Check("impliedVolSolve invalid input", impliedVolSolve(Call, 30000, f, 0, 100).status != IVStatus::InvalidInput, 0);
+    Check("impliedVol NaN without a solution", !std::isnan(impliedVol(Call, 30000, f, t, -1)), 0);
+}
+
+void TestVolSurface()
+{
+    // two BTC expiries with different forwards and smiles, the map keys only order them; the ETH one in between is ignored
+    const double t1 = 0.1, t2 = 0.3, f1 = 36000, f2 = 37000;
+    const CubicSmile s1(f1, t1, 0.6, 0.01, -0.02, 0.03, -0.04), s2(f2, t2, 0.5, 0.02, 0.01, 0.05, 0.02);
+    const std::map<ExpiryKey, std::pair<CubicSmile, double>> fits = {
+        {ExpiryKey{"BTC", datetime_t(2022, 6, 1)}, {s1, 0.0}},
+        {ExpiryKey{"BTC", datetime_t(2022, 8, 1)}, {s2, 0.0}},
+        {ExpiryKey{"ETH", datetime_t(2022, 7, 1)}, {CubicSmile(2500, 0.2, 0.9, 0.1, 0.1, 0.1, 0.1), 0.0}}};
+    const VolSurface<CubicSmile> surface(fits, "BTC");
+    std::vector<double> moneyness;
+    for (double m = 0.5; m <= 1.8; m += 0.001)
+        moneyness.push_back(m);
+
+    // total variance linear in T at constant K / F(T), the forward linear in T
+    double varErr = 0;
+    for (double w = 0.05; w < 1; w += 0.1) {
+        const double T = t1 + w * (t2 - t1), fwd = f1 + w * (f2 - f1);
+        for (double m : moneyness) {
+            const double v1 = s1.Vol(m * f1), v2 = s2.Vol(m * f2);
+            const double expected = (1 - w) * v1 * v1 * t1 + w * v2 * v2 * t2;
+            const double vol = surface.Vol(T, m * fwd);
+            varErr = std::max(varErr, RelativeError(vol * vol * T, expected));
+        }
+    }
+    Check("VolSurface total variance between expiries", varErr, 1e-14);
+    Check("VolSurface expiries of its underlying only", std::fabs(double(surface.NumExpiries()) - 2), 0);
+
+    // flat in T at constant moneyness before the first and after the last expiry
+    double flatErr = 0;
+    for (double m : moneyness) {
+        flatErr = std::max(flatErr, std::fabs(surface.Vol(0.01, m * f1) - s1.Vol(m * f1)));
+        flatErr = std::max(flatErr, std::fabs(surface.Vol(t1, m * f1) - s1.Vol(m * f1)));
+        flatErr = std::max(flatErr, std::fabs(surface.Vol(2.0, m * f2) - s2.Vol(m * f2)));
+    }
+    Check("VolSurface flat extrapolation", flatErr, 0);
+
+    // the batch is the scalar Vol, inside the bracket (over several chunks) and past either end
+    std::vector<double> K(moneyness.size()), out(moneyness.size());
+    double batchErr = 0;
+    for (double T : {0.01, 0.17, 0.29, 2.0}) {
+        for (std::size_t i = 0; i < K.size(); i++)
+            K[i] = moneyness[i] * f1;
+        surface.Vol(T, K.data(), out.data(), K.size());
+        for (std::size_t i = 0; i < K.size(); i++)
+            batchErr = std::max(batchErr, RelativeError(out[i], surface.Vol(T, K[i])));
+    }
+    Check("VolSurface batch Vol vs scalar", batchErr, 1e-15);
+
+    const VolSurface<CubicSmile> empty;
+    empty.Vol(0.2, K.data(), out.data(), K.size());
+    Check("VolSurface NaN when empty",
+          !std::isnan(empty.Vol(0.2, f1)) + std::count_if(out.begin(), out.end(), [](double v) { return !std::isnan(v); }), 0);
+}
+
+void TestGreeksEngine()
+{
+    // BTC and ETH on the same expiry dates; BTC 24JUN22 has no fit, though ETH 24JUN22 does
+    const CubicSmile btcMay(36000, 0.06, 0.6, 0.01, -0.02, 0.03, -0.04), ethMay(2500, 0.06, 0.8, 0.02, 0.03, 0.04, 0.05),
+        ethJun(2600, 0.14, 0.7, 0.01, 0.01, 0.02, 0.02);
+    const std::map<ExpiryKey, std::pair<CubicSmile, double>> fits = {
+        {ExpiryKey{"BTC", datetime_t(2022, 5, 27)}, {btcMay, 0.0}},
+        {ExpiryKey{"ETH", datetime_t(2022, 5, 27)}, {ethMay, 0.0}},
+        {ExpiryKey{"ETH", datetime_t(2022, 6, 24)}, {ethJun, 0.0}}};
+    // interleaved, so portfolio order is not expiry order, and several blocks per expiry
+    struct Line
+    {
+        const char *name;
+        const CubicSmile *smile;
+        double lowStrike, strikeStep;
+    };
+    const Line lines[] = {{"BTC-27MAY22", &btcMay, 20000, 100}, {"ETH-27MAY22", &ethMay, 1000, 5},
+                          {"BTC-24JUN22", nullptr, 20000, 100}, {"ETH-24JUN22", &ethJun, 1000, 5}};
+    std::vector<Position> positions;
+    std::vector<const Line *> positionLine;
+    std::vector<double> positionStrike;
+    for (int i = 0; i < 12000; i++) {
+        const Line &line = lines[i % 4];
+        const double k = line.lowStrike + line.strikeStep * (i / 4 % 300);
+        char name[64];
+        std::snprintf(name, sizeof(name), "%s-%.0f-%c", line.name, k, i / 1200 % 2 ? 'P' : 'C');
+        positions.push_back({name, (i % 7) - 3 + 0.5 * (i % 2)});
+        positionLine.push_back(&line);
+        positionStrike.push_back(k);
+    }
+
+    GreeksEngine<CubicSmile> engine;
+    engine.SetPortfolio(positions);
+    PortfolioGreeks greeks;
+    engine.Compute(fits, greeks);
+
+    // each position priced with bsGreeks off the smile of its own underlying and expiry, totals by quantity
+    double positionErr = 0;
+    std::size_t unpriced = 0;
+    BSGreeks total{};
+    for (std::size_t i = 0; i < positions.size(); i++) {
+        const CubicSmile *smile = positionLine[i]->smile;
+        const double got[] = {greeks.Price[i], greeks.Delta[i], greeks.Gamma[i], greeks.Vega[i], greeks.Theta[i]};
+        if (!smile) {
+            unpriced++;
+            positionErr += std::count_if(std::begin(got), std::end(got), [](double v) { return !std::isnan(v); });
+            continue;
+        }
+        const double k = positionStrike[i];
+        const BSGreeks g = bsGreeks(positions[i].ContractName.back() == 'C' ? Call : Put, k, smile->Forward(),
+                                    smile->TimeToExpiry(), smile->Vol(k));
+        const double expected[] = {g.price, g.delta, g.gamma, g.vega, g.theta};
+        for (int j = 0; j < 5; j++)
+            positionErr = std::max(positionErr, RelativeError(got[j], expected[j]));
+        const double q = positions[i].Quantity;
+        total.price += q * g.price;
+        total.delta += q * g.delta;
+        total.gamma += q * g.gamma;
+        total.vega += q * g.vega;
+        total.theta += q * g.theta;
+    }
+    Check("GreeksEngine per position vs scalar bsGreeks", positionErr, 1e-15);
+    Check("GreeksEngine unpriced positions", std::fabs(double(greeks.NumUnpriced) - double(unpriced)) + (unpriced != 3000), 0);
+    // summed in another order than the scalar loop
+    const double totals[] = {greeks.Total.price, greeks.Total.delta, greeks.Total.gamma, greeks.Total.vega, greeks.Total.theta};
+    const double expectedTotals[] = {total.price, total.delta, total.gamma, total.vega, total.theta};
+    double totalErr = 0;
+    for (int j = 0; j < 5; j++)
+        totalErr = std::max(totalErr, RelativeError(totals[j], expectedTotals[j]));
+    Check("GreeksEngine totals vs scalar bsGreeks", totalErr, 1e-12);
+
+    engine.SetThreads(4);
+    PortfolioGreeks parallel;
+    engine.Compute(fits, parallel);
+    bool same = std::memcmp(&parallel.Total, &greeks.Total, sizeof(BSGreeks)) == 0 && parallel.NumUnpriced == greeks.NumUnpriced;
+    for (auto v : {&PortfolioGreeks::Price, &PortfolioGreeks::Delta, &PortfolioGreeks::Gamma, &PortfolioGreeks::Vega, &PortfolioGreeks::Theta})
+        same = same && std::memcmp((parallel.*v).data(), (greeks.*v).data(), positions.size() * sizeof(double)) == 0;
+    Check("GreeksEngine 4 threads vs 1", !same, 0);
+}
+
+} // namespace
+
+int main()
+{
+    std::mt19937_64 rng(633);
+    std::cout << "SIMD backend width: " << simd::NativeOps::Width << std::endl;
+    TestSimdMath(rng);
+    TestSpecialFunctions(rng);
+    TestBatchBlackScholes(rng);
+    TestGreeks(rng);
+    TestImpliedVol(rng);
+    TestVolSurface();
+    TestGreeksEngine();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,318 @@
+#include <iostream>
+#include <algorithm>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CsvFeeder.h"
+#include "CubicSmile.h"
+#include "PartitionedReplay.h"
+#include "ShardedReplay.h"
+#include "SmileWriter.h"
+#include "TickGenerator.h"
+#include "VolSurfBuilder.h"
+
+// End-to-end checks of the replay pipeline on generated captures; returns non-zero if any check fails.
+
+// counts every heap allocation of the process, for the steady state replay check
+static std::atomic<uint64_t> numAllocations{0};
+
+void *operator new(std::size_t size)
+{
+    numAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+int failures = 0;
+
+void Check(const char *name, double maxError, double tolerance)
+{
+    const bool ok = maxError <= tolerance;
+    std::cout << (ok ? "ok    " : "FAILED") << " " << name << ": max error " << maxError << " (tolerance " << tolerance << ")" << std::endl;
+    failures += !ok;
+}
+
+void CheckCount(const char *name, uint64_t count, uint64_t expected)
+{
+    const bool ok = count == expected;
+    std::cout << (ok ? "ok    " : "FAILED") << " " << name << ": " << count << " (expected " << expected << ")" << std::endl;
+    failures += !ok;
+}
+
+// the whole capture of generator as a csv in the temp directory
+std::string WriteCapture(TickGenerator &generator, const char *filename)
+{
+    const std::string path = (std::filesystem::temp_directory_path() / filename).string();
+    std::ofstream out(path);
+    WriteTickCsvHeader(out);
+    Msg msg;
+    while (generator.Next(msg)) {
+        WriteTickCsvRows(out, msg);
+    }
+    return path;
+}
+
+void Replay(const std::string &path, VolSurfBuilder<CubicSmile> &builder)
+{
+    CsvFeeder feeder(path, [&builder](const Msg &msg) { builder.Process(msg); }, std::chrono::minutes(1), [](uint64_t) {});
+    while (feeder.Step()) {
+    }
+}
+
+SmileRecord ToRecord(uint64_t now_ms, const std::pair<const ExpiryKey, std::pair<CubicSmile, double>> &fit)
+{
+    SmileRecord r;
+    r.TimeMS = now_ms;
+    r.ExpiryMS = fit.first.Expiry.UnixMS();
+    std::copy(fit.second.first.params.begin(), fit.second.first.params.end(), r.Params);
+    r.FitError = fit.second.second;
+    return r;
+}
+
+// the smiles fitted at now_ms, as step3 writes them
+void AppendFits(VolSurfBuilder<CubicSmile> &builder, uint64_t now_ms, std::vector<SmileRecord> &records)
+{
+    for (const auto &fit : builder.FitSmiles()) {
+        records.push_back(ToRecord(now_ms, fit));
+    }
+}
+
+// the same, one list per underlying
+void AppendFits(VolSurfBuilder<CubicSmile> &builder, uint64_t now_ms, std::map<std::string, std::vector<SmileRecord>> &records)
+{
+    for (const auto &fit : builder.FitSmiles()) {
+        records[fit.first.Underlying].push_back(ToRecord(now_ms, fit));
+    }
+}
+
+// records of a and b that are not bit-identical, the longer one's extra records included
+uint64_t CountDifferences(const std::vector<SmileRecord> &a, const std::vector<SmileRecord> &b)
+{
+    const std::size_t n = std::min(a.size(), b.size());
+    uint64_t differences = std::max(a.size(), b.size()) - n;
+    for (std::size_t i = 0; i < n; i++) {
+        differences += std::memcmp(&a[i], &b[i], sizeof(SmileRecord)) != 0;
+    }
+    return differences;
+}
+
+// a generated capture replays through CsvFeeder into the smiles it was quoted from
+void TestGeneratedRefit()
+{
+    TickGeneratorConfig config;
+    config.DurationMS = 120000;
+    config.SpotVol = 0;
+    TickGenerator generator(config);
+    const std::string path = WriteCapture(generator, "qf633_test_refit.csv");
+    VolSurfBuilder<CubicSmile> builder;
+    Replay(path, builder);
+    std::filesystem::remove(path);
+
+    const auto fits = builder.FitSmiles();
+    double maxParamError = fits.size() == generator.Truth().size() ? 0 : 1;
+    for (const ExpiryTruth &truth : generator.Truth()) {
+        const auto fit = fits.find(ExpiryKey{config.Underlying, truth.Expiry});
+        if (fit == fits.end()) {
+            maxParamError = 1;
+            continue;
+        }
+        const double expected[] = {truth.AtmVol, truth.Bf25, truth.Rr25, truth.Bf10, truth.Rr10};
+        for (int i = 0; i < 5; i++) {
+            maxParamError = std::max(maxParamError, std::fabs(fit->second.first.params[i + 1] - expected[i]));
+        }
+    }
+    Check("generated smiles refitted, parameters", maxParamError, 1e-5);
+}
+
+// replaying a capture again, with every name interned and the builder's slots in place, allocates nothing per message
+void TestSteadyStateAllocations()
+{
+    TickGeneratorConfig config;
+    config.DurationMS = 120000;
+    TickGenerator generator(config);
+    const std::string path = WriteCapture(generator, "qf633_test_allocations.csv");
+    VolSurfBuilder<CubicSmile> builder;
+    Replay(path, builder);
+    {
+        CsvFeeder again(path, [&builder](const Msg &msg) { builder.Process(msg); }, std::chrono::minutes(1), [](uint64_t) {});
+        const uint64_t before = numAllocations.load();
+        while (again.Step()) {
+        }
+        CheckCount("heap allocations of a warm CsvFeeder -> VolSurfBuilder replay", numAllocations.load() - before, 0);
+    }
+    std::filesystem::remove(path);
+}
+
+// the backtest mode of step3: a capture split at its snapshots and replayed on several threads fits the same smiles
+void TestPartitionedReplay()
+{
+    TickGeneratorConfig config;
+    config.SnapIntervalMS = 20 * 60000;
+    TickGenerator generator(config);
+    const std::string path = WriteCapture(generator, "qf633_test_partitioned.csv");
+    const auto interval = std::chrono::minutes(1);
+
+    std::vector<SmileRecord> serial;
+    {
+        VolSurfBuilder<CubicSmile> builder;
+        CsvFeeder feeder(path, [&builder](const Msg &msg) { builder.Process(msg); }, interval,
+                         [&builder, &serial](uint64_t now_ms) { AppendFits(builder, now_ms, serial); });
+        while (feeder.Step()) {
+        }
+    }
+
+    PartitionedReplay replay(path, interval);
+    std::vector<std::unique_ptr<VolSurfBuilder<CubicSmile>>> builders(replay.NumChunks());
+    std::vector<std::vector<SmileRecord>> chunkRecords(replay.NumChunks());
+    std::vector<SmileRecord> partitioned;
+    replay.Run(
+        4,
+        [&](std::size_t chunk) {
+            builders[chunk] = std::make_unique<VolSurfBuilder<CubicSmile>>();
+            VolSurfBuilder<CubicSmile> *builder = builders[chunk].get();
+            return PartitionedReplay::Listeners{
+                [builder](const Msg &msg) { builder->Process(msg); },
+                [builder, &chunkRecords, chunk](uint64_t now_ms) { AppendFits(*builder, now_ms, chunkRecords[chunk]); }};
+        },
+        [&](std::size_t chunk) {
+            partitioned.insert(partitioned.end(), chunkRecords[chunk].begin(), chunkRecords[chunk].end());
+        });
+    std::filesystem::remove(path);
+
+    CheckCount("snapshot chunks of the partitioned capture", replay.NumChunks(), 3);
+    CheckCount("smiles of a 4 thread partitioned replay differing from the serial one", CountDifferences(serial, partitioned), 0);
+    // one timer call a minute over the hour, every expiry fitted in each
+    CheckCount("smiles fitted by the serial replay", serial.size(), 60 * config.NumExpiries);
+}
+
+// one builder per underlying on its own thread fits what one builder fed the whole capture fits, as step3 does
+void TestShardedReplay()
+{
+    // BTC and ETH quoted in one capture with the same expiry dates, rows of both sharing a timestamp in one message
+    TickGeneratorConfig btc, eth;
+    btc.DurationMS = eth.DurationMS = 30 * 60000;
+    eth.Underlying = "ETH";
+    eth.Spot = 2500;
+    eth.Seed = 634;
+    std::vector<Msg> messages;
+    for (const TickGeneratorConfig &config : {btc, eth}) {
+        TickGenerator generator(config);
+        Msg msg;
+        while (generator.Next(msg)) {
+            messages.push_back(msg);
+        }
+    }
+    std::stable_sort(messages.begin(), messages.end(), [](const Msg &a, const Msg &b) { return a.timestamp < b.timestamp; });
+    const std::string path = (std::filesystem::temp_directory_path() / "qf633_test_sharded.csv").string();
+    {
+        std::ofstream out(path);
+        WriteTickCsvHeader(out);
+        for (const Msg &msg : messages) {
+            WriteTickCsvRows(out, msg);
+        }
+    }
+    const auto interval = std::chrono::minutes(1);
+
+    std::map<std::string, std::vector<SmileRecord>> serial;
+    {
+        VolSurfBuilder<CubicSmile> builder;
+        CsvFeeder feeder(path, [&builder](const Msg &msg) { builder.Process(msg); }, interval,
+                         [&builder, &serial](uint64_t now_ms) { AppendFits(builder, now_ms, serial); });
+        while (feeder.Step()) {
+        }
+    }
+
+    // every shard only ever fits its own underlying, into its own map
+    struct Shard
+    {
+        VolSurfBuilder<CubicSmile> builder;
+        std::map<std::string, std::vector<SmileRecord>> records;
+    };
+    std::map<std::string, std::unique_ptr<Shard>> shards;
+    ShardedReplay replay({path}, [&shards](const std::string &underlying) {
+        Shard *shard = (shards[underlying] = std::make_unique<Shard>()).get();
+        return ShardedReplay::Listeners{[shard](const Msg &msg) { shard->builder.Process(msg); },
+                                        [shard](uint64_t now_ms) { AppendFits(shard->builder, now_ms, shard->records); }};
+    }, interval);
+    replay.Run();
+    std::filesystem::remove(path);
+
+    std::map<std::string, std::vector<SmileRecord>> sharded;
+    for (const auto &shard : shards) {
+        sharded.insert(shard.second->records.begin(), shard.second->records.end());
+    }
+    uint64_t differences = 0, fitted = 0;
+    for (const auto &records : serial) {
+        const auto other = sharded.find(records.first);
+        differences += other == sharded.end() ? records.second.size() : CountDifferences(records.second, other->second);
+        fitted += records.second.size();
+    }
+    CheckCount("shards of a BTC and ETH capture", shards.size(), 2);
+    CheckCount("underlyings fitted by one builder", serial.size(), 2);
+    CheckCount("underlyings fitted by the shards", sharded.size(), 2);
+    CheckCount("smiles of the sharded replay differing from the single builder's", differences, 0);
+    // both underlyings from the first snapshot, one timer call a minute, every expiry of each fitted in each
+    CheckCount("smiles fitted by the single builder", fitted, 2 * 30 * btc.NumExpiries);
+}
+
+// smiles written by SmileWriter in the binary format, over several batches and two writers appending, read back
+void TestSmileLogRoundTrip()
+{
+    std::vector<SmileRecord> records(1000);
+    for (std::size_t i = 0; i < records.size(); i++) {
+        SmileRecord &r = records[i];
+        r.TimeMS = 1651795200000ULL + i / 8 * 60000;
+        r.ExpiryMS = 1652342400000LL + static_cast<int64_t>(i % 8) * 604800000;
+        for (int p = 0; p < 6; p++) {
+            r.Params[p] = std::sin(1.0 + i * 7 + p) / (p + 1);
+        }
+        r.FitError = 1e-6 * (i % 13);
+    }
+    const std::string path = (std::filesystem::temp_directory_path() / "qf633_test_smiles.bin").string();
+    std::filesystem::remove(path);
+    const std::size_t firstRun = 600;
+    for (std::size_t begin : {std::size_t(0), firstRun}) {
+        SmileWriterOptions options;
+        options.Path = path;
+        options.Format = SmileFormat::Binary;
+        options.BatchRecords = 64;
+        SmileWriter writer(options);
+        const std::size_t end = begin == 0 ? firstRun : records.size();
+        for (std::size_t i = begin; i < end; i += 8) {
+            writer.Write(&records[i], std::min<std::size_t>(8, end - i));
+        }
+        writer.Close();
+    }
+    const std::vector<SmileRecord> read = ReadSmileLog(path);
+    std::filesystem::remove(path);
+    CheckCount("smile log records differing from the written ones", CountDifferences(records, read), 0);
+}
+
+} // namespace
+
+int main()
+{
+    TestGeneratedRefit();
+    TestSteadyStateAllocations();
+    TestPartitionedReplay();
+    TestShardedReplay();
+    TestSmileLogRoundTrip();
+    return failures == 0 ? 0 : 1;
+}
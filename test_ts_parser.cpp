@@ -1,10 +1,99 @@
 #include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CsvFeeder.h"
 
 int main() {
-    // declare the function implemented in CsvFeeder.cpp
-    uint64_t TimeToUnixMS(std::string ts);
     std::string ts("2022-05-06T00:00:00.139Z");
     auto r = TimeToUnixMS(ts);
     std::cout << "timestamp \"" << ts << "\"'s unix epoch (millisecond) is " << r << std::endl;
-    return 0;
-}
\ No newline at end of file
+    if (r != 1651795200139ULL) {
+        std::cerr << "FAILED: expected 1651795200139" << std::endl;
+        return 1;
+    }
+
+    // correctness: the fixed-format fast path must agree with date::parse on every input
+    std::mt19937_64 rng(633);
+    std::vector<std::string> samples;
+    char buf[64];
+    for (int i = 0; i < 200000; i++) {
+        const int y = 1970 + rng() % 130;
+        const int m = 1 + rng() % 12;
+        const int d = 1 + rng() % 28 + (m != 2 && rng() % 2 ? 2 : 0);
+        const int fracDigits = rng() % 7;
+        int n = std::snprintf(buf, sizeof(buf), "%04d-%02d-%02dT%02d:%02d:%02d", y, m, d,
+                              int(rng() % 24), int(rng() % 60), int(rng() % 60));
+        if (fracDigits > 0) {
+            n += std::snprintf(buf + n, sizeof(buf) - n, ".%0*llu", fracDigits,
+                               (unsigned long long)(rng() % 1000000) % (unsigned long long)std::pow(10, fracDigits));
+        }
+        if (rng() % 4) {
+            std::snprintf(buf + n, sizeof(buf) - n, "Z");
+        }
+        samples.emplace_back(buf);
+    }
+    // leap days, month ends and inputs the fast path has to hand over to date::parse
+    const char *edgeCases[] = {"2020-02-29T23:59:59.999Z", "2000-02-29T00:00:00.000Z", "2022-12-31T23:59:59.999Z",
+                               "2022-05-06T00:00:00Z", "2022-05-06T00:00:00.1Z", "2022-05-06T00:00:00.123456789Z",
+                               "1970-01-01T00:00:00.000Z", "2022-05-06 00:00:00.139Z", "2022-5-6T00:00:00.139Z",
+                               "2022-05-06T00:00:00.139+00:00", "2022-05-06T00:00:00."};
+    for (const char *s : edgeCases) {
+        samples.emplace_back(s);
+    }
+
+    int failures = 0;
+    for (const auto &s : samples) {
+        const uint64_t fast = TimeToUnixMS(s.data(), s.size());
+        const uint64_t slow = DateParseTimeToUnixMS(s);
+        if (fast != slow) {
+            if (++failures <= 10) {
+                std::cerr << "mismatch for " << s << ": " << fast << " != " << slow << std::endl;
+            }
+        }
+    }
+    std::cout << samples.size() << " timestamps checked, " << failures << " mismatches" << std::endl;
+
+    // civil date engine: DaysFromCivil and CivilFromDays are inverse, day after day, over four centuries
+    static_assert(DaysFromCivil(1970, 1, 1) == 0 && DaysFromCivil(2000, 3, 1) == 11017, "days from civil");
+    static_assert(datetime_t(2022, 5, 27) - datetime_t(2022, 5, 6) == 21 / 365.0, "ACT/365 year fraction");
+    static_assert(datetime_t(1969, 12, 31, 23, 59, 59).Day() == 31 && datetime_t(1969, 12, 31, 23, 59, 59).Hour() == 23,
+                  "dates before the epoch");
+    int dateFailures = 0;
+    CivilDate previous = CivilFromDays(DaysFromCivil(1800, 1, 1) - 1);
+    for (int64_t z = DaysFromCivil(1800, 1, 1); z < DaysFromCivil(2200, 1, 1); z++) {
+        const CivilDate c = CivilFromDays(z);
+        const bool next = c.day == previous.day + 1 ? c.month == previous.month && c.year == previous.year
+                                                    : c.day == 1 && previous.day == DaysInMonth(previous.year, previous.month);
+        if (!next || DaysFromCivil(c.year, c.month, c.day) != z) {
+            dateFailures++;
+        }
+        previous = c;
+    }
+    std::cout << "civil dates 1800-2199 checked, " << dateFailures << " mismatches" << std::endl;
+    failures += dateFailures;
+
+    // throughput: rows of a capture share their date, which is what the date cache is for
+    std::vector<std::string> rows;
+    for (int i = 0; i < 1000000; i++) {
+        std::snprintf(buf, sizeof(buf), "2022-05-06T%02d:%02d:%02d.%03dZ", i / 3600000 % 24, i / 60000 % 60, i / 1000 % 60, i % 1000);
+        rows.emplace_back(buf);
+    }
+    auto bench = [&rows](const char *name, auto &&parse) {
+        uint64_t checksum = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (const auto &s : rows) {
+            checksum += parse(s);
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << name << ": " << rows.size() / elapsed.count() / 1e6 << "M timestamps/s (checksum " << checksum << ")" << std::endl;
+    };
+    bench("date::parse", [](const std::string &s) { return DateParseTimeToUnixMS(s); });
+    bench("fast path  ", [](const std::string &s) { return TimeToUnixMS(s.data(), s.size()); });
+
+    return failures == 0 ? 0 : 1;
+}